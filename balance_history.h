@@ -0,0 +1,152 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef BALANCE_HISTORY_H
+#define BALANCE_HISTORY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Where decoding a BalanceHistory can start: the balance as of date, with
+// the entries after it from byte offset on.
+struct BalanceCheckpoint
+{
+    uint64_t date;
+    uint32_t balance;
+    uint32_t offset;
+};
+
+// Every balance an account has had, for answering "balance as of T".
+//
+// An entry is the change of one executed transaction, delta encoded against
+// the entry before it: the date difference and the zigzagged balance
+// difference as varints, usually 3 to 5 bytes where a plain date and balance
+// take 12. A checkpoint every checkpointEvery entries stores the absolute
+// date and balance, so a lookup binary searches the checkpoints and then
+// decodes at most checkpointEvery entries. Until its first change an
+// account keeps the opening date and balance in lastDate and lastBalance,
+// which the first change turns into the first checkpoint, so an account
+// that never transacts allocates nothing.
+//
+// Transactions execute in date order, so the dates never decrease.
+class BalanceHistory {
+public:
+    static constexpr size_t DEFAULT_CHECKPOINT = 32;
+
+    BalanceHistory() = default;
+    BalanceHistory(uint64_t opened, uint32_t balance)
+        : lastDate(opened), lastBalance(balance) {}
+
+    uint32_t latest() const { return lastBalance; }
+    const std::vector<uint8_t>& data() const { return encoded; }
+    const std::vector<BalanceCheckpoint>& checkpointList() const { return checkpoints; }
+
+    // the balance became balance at date
+    void record(uint64_t date, uint32_t balance, size_t checkpointEvery) {
+        if (checkpoints.empty()) {
+            checkpoints.push_back({lastDate, lastBalance, 0}); // the opening
+        } else if (sinceCheckpoint >= checkpointEvery) {
+            checkpoints.push_back({lastDate, lastBalance, static_cast<uint32_t>(encoded.size())});
+            sinceCheckpoint = 0;
+        }
+        putVarint(date - lastDate);
+        int64_t change = static_cast<int64_t>(balance) - static_cast<int64_t>(lastBalance);
+        putVarint((static_cast<uint64_t>(change) << 1) ^ static_cast<uint64_t>(change >> 63));
+        lastDate = date;
+        lastBalance = balance;
+        sinceCheckpoint++;
+    }
+
+    // the balance after every change up to and including date, false before the opening
+    bool balanceAt(uint64_t date, uint32_t& balance) const {
+        if (checkpoints.empty()) {
+            balance = lastBalance;
+            return date >= lastDate;
+        }
+        auto after = std::upper_bound(checkpoints.begin(), checkpoints.end(), date,
+            [](uint64_t left, const BalanceCheckpoint& right) { return left < right.date; });
+        if (after == checkpoints.begin()) return false;
+        const BalanceCheckpoint& from = *(after - 1);
+        size_t end = (after == checkpoints.end()) ? encoded.size() : after->offset;
+        uint64_t entryDate = from.date;
+        balance = from.balance;
+        for (size_t pos = from.offset; pos < end;)
+        {
+            entryDate += getVarint(pos);
+            if (entryDate > date) break;
+            balance = applyChange(balance, getVarint(pos));
+        }
+        return true;
+    }
+
+    // takes over an encoding written out from data() and checkpointList(); an
+    // empty one is an account that never changed, which keeps its opening
+    void restore(std::vector<uint8_t> encoded_in, std::vector<BalanceCheckpoint> checkpoints_in) {
+        if (checkpoints_in.empty()) return;
+        encoded = std::move(encoded_in);
+        checkpoints = std::move(checkpoints_in);
+        lastDate = checkpoints.back().date;
+        lastBalance = checkpoints.back().balance;
+        sinceCheckpoint = 0;
+        for (size_t pos = checkpoints.back().offset; pos < encoded.size(); sinceCheckpoint++)
+        {
+            lastDate += getVarint(pos);
+            lastBalance = applyChange(lastBalance, getVarint(pos));
+        }
+    }
+
+    // whether restore() can decode this encoding: whole entries, each checkpoint at the start of one
+    static bool valid(const std::vector<uint8_t>& encoded_in, const std::vector<BalanceCheckpoint>& checkpoints_in) {
+        if (checkpoints_in.empty()) return encoded_in.empty();
+        if (checkpoints_in[0].offset != 0) return false;
+        size_t checkpoint = 1;
+        size_t pos = 0;
+        while (true)
+        {
+            for (; checkpoint < checkpoints_in.size() && checkpoints_in[checkpoint].offset == pos; checkpoint++) {
+                if (checkpoints_in[checkpoint].date < checkpoints_in[checkpoint - 1].date) return false;
+            }
+            if (pos == encoded_in.size()) break;
+            // two varints, each ends on a byte with the high bit clear
+            for (int varint = 0; varint < 2; varint++) {
+                while (pos < encoded_in.size() && (encoded_in[pos] & 0x80) != 0) pos++;
+                if (pos++ == encoded_in.size()) return false;
+            }
+        }
+        return checkpoint == checkpoints_in.size();
+    }
+
+private:
+    std::vector<uint8_t> encoded;
+    std::vector<BalanceCheckpoint> checkpoints;
+    uint64_t lastDate = 0;
+    uint32_t lastBalance = 0;
+    uint32_t sinceCheckpoint = 0; // entries after the last checkpoint
+
+    void putVarint(uint64_t value) {
+        while (value >= 0x80)
+        {
+            encoded.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        encoded.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint64_t getVarint(size_t& pos) const {
+        uint64_t value = 0;
+        for (unsigned shift = 0;; shift += 7)
+        {
+            uint8_t byte = encoded[pos++];
+            if (shift < 64) value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return value;
+        }
+    }
+
+    static uint32_t applyChange(uint32_t balance, uint64_t zigzag) {
+        int64_t change = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+        return static_cast<uint32_t>(static_cast<int64_t>(balance) + change);
+    }
+};
+
+#endif
@@ -1,6 +1,5 @@
 // Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
 #include <iostream>
-#include <queue>
 #include <vector>
 #include <getopt.h>
 #include <string>
@@ -9,104 +8,62 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <string_view>
+#include <charconv>
+#include <memory>
+#include <chrono>
+#include <fcntl.h>
+#include <variant>
+#include <queue>
+#include <numeric>
+#include <sys/stat.h>
+#include "command_reader.h"
+#include "command_pipeline.h"
+#include "name_table.h"
+#include "user.h"
+#include "transaction.h"
+#include "transaction_log.h"
+#include "scheduler.h"
+#include "output_writer.h"
+#include "thread_pool.h"
+#include "bank_state.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "due_batch.h"
+#include "fee.h"
+#include "journal.h"
+#include "engine_log.h"
+#include "server.h"
+#include "timestamp.h"
+#include "work_stealing_pool.h"
 
 using namespace std;
 
-class User {
-public:
-    unsigned int balance;
-    string pin;
-    uint64_t reg_timestamp;
-    unordered_set<string> activeSession;
-    vector<unsigned int> incoming; // store index in transactions when self as recipient
-    vector<unsigned int> outcoming; // store index in transactions when self as sende 
-    User() = default;
-    User(unsigned int bal, string p, uint64_t reg_time) 
-        : balance(bal), pin(p), reg_timestamp(reg_time) {}
-    
-    void Login(string USER_ID, string IP, bool verbose_was_set) {
-        activeSession.insert(IP);
-        if (verbose_was_set)
-        {
-            cout << "User " << USER_ID << " logged in.\n";
-        }   
-    }
-
-    void Logout(string USER_ID, string IP, bool verbose_was_set) {
-        if (activeSession.find(IP) != activeSession.end())
-        {   
-            activeSession.erase(IP);
-            if (verbose_was_set)
-            {
-                cout << "User " << USER_ID << " logged out.\n";
-            }   
-        } else {
-            if (verbose_was_set)
-            {
-                cout << "Logout failed for " << USER_ID << ".\n";
-            }   
-        }
-    }
-
-    void Balance(string ACCOUNT, string IP, bool verbose_was_set, bool recentPlace_was_set, uint64_t recentPlace_timestamp) {
-        if (activeSession.empty()) {
-            if (verbose_was_set)
-            {
-                cout << "Account " << ACCOUNT << " is not logged in.\n";
-            }
-        } else if (activeSession.find(IP) != activeSession.end()) {
-            uint64_t balance_timestamp;
-            if (recentPlace_was_set)
-            {
-                balance_timestamp = recentPlace_timestamp;
-            } else {
-                balance_timestamp = reg_timestamp;
-            }
-            cout << "As of " << balance_timestamp << ", " << ACCOUNT << " has a balance of $" << balance << ".\n";
-        } else {
-            if (verbose_was_set)
-            {
-                cout << "Fraudulent transaction detected, aborting request.\n";
-            }
-        }
-        
-    }
-
-};
-
-struct Transaction
-{
-    uint64_t executeDate;
-    unsigned int transactionID;
-    unsigned int amount;
-    string sender;
-    string recipient;
-    string feeMode;
-    unsigned bankfee;
-    Transaction(uint64_t execDate, unsigned int transID, unsigned int amt, 
-                const std::string& sndr, const std::string& rcpt, const std::string& fee)
-        : executeDate(execDate), transactionID(transID), amount(amt), 
-          sender(sndr), recipient(rcpt), feeMode(fee) {}
-};
-
-struct SortByExecuteDate 
-{
-    bool operator()(const Transaction &left, const Transaction &right) const {
-        if (left.executeDate == right.executeDate) {
-            return left.transactionID > right.transactionID;
-        }
-        return left.executeDate > right.executeDate;
-    }
-};
-
-bool compareExecuteDate(const Transaction& transaction, uint64_t date) {
-    return transaction.executeDate < date;
-}
+// output fragments indexed by (count != 1)
+constexpr string_view DOLLAR_TO[] = {" dollar to ", " dollars to "};
+constexpr string_view WAS_WERE[] = {"was", "were"};
+constexpr string_view TRANSACTION_THAT[] = {" transaction that ", " transactions that "};
+constexpr string_view TRANSACTION_COMMA[] = {" transaction, ", " transactions, "};
 
 static option long_options[] = {
     {"file",      required_argument, nullptr, 'f'},
     {"verbose",   no_argument,       nullptr, 'v'},
     {"help",      no_argument,       nullptr, 'h'},
+    {"snapshot-in",  required_argument, nullptr, 'I'},
+    {"snapshot-out", required_argument, nullptr, 'O'},
+    {"stats",        no_argument,       nullptr, 'S'},
+    {"stats-json",   required_argument, nullptr, 'J'},
+    {"online",       no_argument,       nullptr, 'Q'},
+    {"journal",      required_argument, nullptr, 'W'},
+    {"recover",      required_argument, nullptr, 'R'},
+    {"group-commit", required_argument, nullptr, 'G'},
+    {"archive",      required_argument, nullptr, 'A'},
+    {"pipeline",     no_argument,       nullptr, 'P'},
+    {"balance-checkpoint", required_argument, nullptr, 'B'},
+    {"serve",        required_argument, nullptr, 'D'},
+    {"batch",        required_argument, nullptr, 'M'},
+    {"jobs",         required_argument, nullptr, 'N'},
+    {"events",       required_argument, nullptr, 'E'},
     {nullptr,      0,                 nullptr,  0}
 };
 
@@ -119,26 +76,49 @@ string get_optarg_argument_as_string() {
 }
 
 // Common function
-void readUser(const string filename, unordered_map<string, User>& users);
-uint64_t convertTimeStamp(string timestamp);
-unsigned calculateBankFee(unsigned int amount, string feeMode, unordered_map<std::string, User>::iterator Iter, u_int64_t execute_ts, bool isSender);
-pair<vector<Transaction>::const_iterator, vector<Transaction>::const_iterator> findTransactionsInRange(const vector<Transaction>& transactions, uint64_t x, uint64_t y);
-string timeIntervaltoFormat(u_int64_t timeInterval);
-
-// Function for User Commands
-void updateToCurrentTimeStamp(unordered_map<string, User>& users, priority_queue<Transaction, vector<Transaction>, SortByExecuteDate> &unexecutedTransactions, 
-            vector<Transaction> &transactions, unsigned &transactionIDSuccessed, bool& verbose_was_set, uint64_t place_timestamp);
-void login(stringstream& ss, unordered_map<string, User>& users, bool& verbose_was_set);
-void out(stringstream& ss, unordered_map<string, User>& users, bool& verbose_was_set);
-void balance(stringstream& ss, unordered_map<string, User>& users, bool& verbose_was_set, bool& recentPlace_was_set, uint64_t& recentPlace_timestamp);
-void place(stringstream& ss, unordered_map<string, User>& users, bool& verbose_was_set, bool& recentPlace_was_set, uint64_t& recentPlace_timestamp, 
-            priority_queue<Transaction, vector<Transaction>, SortByExecuteDate> &unexecutedTransactions, vector<Transaction> &transactions, unsigned &transactionIDSuccessed, unsigned int& transactionID);
+size_t readUser(const string filename, vector<User>& users, NameTable& userNames, ThreadPool& pool);
+uint64_t convertTimeStamp(string_view timestamp);
+pair<size_t, size_t> findTransactionsInRange(const TransactionLog& transactions, uint64_t x, uint64_t y);
+void writeTimeInterval(OutputWriter& output, u_int64_t timeInterval);
+void writeTransaction(OutputWriter& output, const TransactionLog& transactions, size_t i, const NameTable& userNames);
+unsigned int parseAmount(string_view amount);
+FeeMode toFeeMode(string_view feeMode);
+
+// Function for User Commands, each one built for QuietLog, VerboseLog and EventLog (engine_log.h)
+template <typename Log>
+void updateToCurrentTimeStamp(vector<User>& users, const NameTable& userNames, CalendarQueue &unexecutedTransactions, 
+            TransactionLog &transactions, unsigned &transactionIDSuccessed, Log& log, uint64_t place_timestamp, size_t balanceCheckpoint, DueBatch& batch, Journal& journal, OutputWriter& output);
+template <typename Log>
+void login(const CommandFields& fields, vector<User>& users, const NameTable& userNames, SessionStore& sessions, Log& log, Journal& journal, OutputWriter& output);
+template <typename Log>
+void out(const CommandFields& fields, vector<User>& users, const NameTable& userNames, SessionStore& sessions, Log& log, Journal& journal, OutputWriter& output);
+template <typename Log>
+void balance(const CommandFields& fields, vector<User>& users, const NameTable& userNames, const SessionStore& sessions, Log& log, bool& recentPlace_was_set, uint64_t& recentPlace_timestamp, OutputWriter& output);
+template <typename Log>
+void place(const CommandFields& fields, vector<User>& users, const NameTable& userNames, const SessionStore& sessions, Log& log, bool& recentPlace_was_set, uint64_t& recentPlace_timestamp, 
+            CalendarQueue &unexecutedTransactions, TransactionLog &transactions, unsigned &transactionIDSuccessed, unsigned int& transactionID, size_t balanceCheckpoint, DueBatch& batch, Journal& journal, OutputWriter& output);
+template <typename Log>
+void runCommand(const CommandFields& fields, BankState& state, Log& log, bool online_was_set, size_t balanceCheckpoint, DueBatch& batch, Journal& journal, OutputWriter& output);
+
+// the log a run reports its events to, chosen once from -v and --events
+using EngineLog = variant<QuietLog, VerboseLog, EventLog>;
+
+// Function for --batch
+bool runBatch(const string& manifest, unsigned threads, bool verbose_was_set, bool online_was_set, size_t balanceCheckpoint);
 
 // Fundtion for Query list
-void ListTransactions(stringstream& ss, vector<Transaction> &transactions);
-void BankRevenue(stringstream& ss, vector<Transaction> &transactions);
-void CustomerHistory(stringstream& ss, vector<Transaction> &transactions, unordered_map<string, User>& users);
-void SummarizeDay(stringstream& ss, vector<Transaction> &transactions);
+bool isQuery(string_view command);
+void runQueries(const vector<string_view>& queries, const TransactionLog &transactions, 
+            const vector<User>& users, const NameTable& userNames, ThreadPool& pool, OutputWriter& output);
+void answerQuery(const CommandFields& fields, const TransactionLog &transactions, 
+            const vector<User>& users, const NameTable& userNames, OutputWriter& output);
+void ListTransactions(const CommandFields& fields, const TransactionLog &transactions, const NameTable& userNames, OutputWriter& output);
+void BankRevenue(const CommandFields& fields, const TransactionLog &transactions, OutputWriter& output);
+void CustomerHistory(const CommandFields& fields, const TransactionLog &transactions, const vector<User>& users, const NameTable& userNames, OutputWriter& output);
+void SummarizeDay(const CommandFields& fields, const TransactionLog &transactions, const NameTable& userNames, OutputWriter& output);
+void BalanceAsOf(const CommandFields& fields, const vector<User>& users, const NameTable& userNames, OutputWriter& output);
+void HistoryPage(const CommandFields& fields, const TransactionLog &transactions, const vector<User>& users, const NameTable& userNames, OutputWriter& output);
+void TopAccounts(const CommandFields& fields, const TransactionLog &transactions, const NameTable& userNames, OutputWriter& output);
 
 
 int main(int argc, char** argv) {
@@ -147,8 +127,16 @@ int main(int argc, char** argv) {
     {
         string filename;
 
+        string snapshotIn, snapshotOut, statsJson, journalFile, recoverFile, archiveDirectory, serveSocket, batchManifest, eventsFile;
+        unsigned jobs = thread::hardware_concurrency();
+        size_t groupCommit = Journal::DEFAULT_GROUP;
+        size_t balanceCheckpoint = BalanceHistory::DEFAULT_CHECKPOINT;
+
         bool file_was_set = false;
         bool verbose_was_set = false;
+        bool stats_was_set = false;
+        bool online_was_set = false;
+        bool pipeline_was_set = false;
 
 
         int choice = 0;
@@ -161,12 +149,102 @@ int main(int argc, char** argv) {
             case 'v':
                 verbose_was_set = true;
                 break;
+            case 'I':
+                snapshotIn = get_optarg_argument_as_string();
+                break;
+            case 'O':
+                snapshotOut = get_optarg_argument_as_string();
+                break;
+            case 'S':
+                stats_was_set = true;
+                break;
+            case 'J':
+                statsJson = get_optarg_argument_as_string();
+                break;
+            case 'Q':
+                online_was_set = true;
+                break;
+            case 'W':
+                journalFile = get_optarg_argument_as_string();
+                break;
+            case 'R':
+                recoverFile = get_optarg_argument_as_string();
+                break;
+            case 'P':
+                pipeline_was_set = true;
+                break;
+            case 'A':
+                archiveDirectory = get_optarg_argument_as_string();
+                break;
+            case 'G':
+                groupCommit = stoul(get_optarg_argument_as_string());
+                if (groupCommit == 0) throw "--group-commit takes a positive number of commands\n";
+                break;
+            case 'D':
+                serveSocket = get_optarg_argument_as_string();
+                break;
+            case 'E':
+                eventsFile = get_optarg_argument_as_string();
+                break;
+            case 'M':
+                batchManifest = get_optarg_argument_as_string();
+                break;
+            case 'N':
+                jobs = static_cast<unsigned>(stoul(get_optarg_argument_as_string()));
+                if (jobs == 0) throw "--jobs takes a positive number of threads\n";
+                break;
+            case 'B':
+                balanceCheckpoint = stoul(get_optarg_argument_as_string());
+                if (balanceCheckpoint == 0) throw "--balance-checkpoint takes a positive number of entries\n";
+                break;
             case 'h':
                 std::cout <<
                 " --file/-f filename\n"
                 "         This is followed by a filename for the registration file.\n"
                 " --verbose/-v\n"
                 "         This causes the program to print certain log messages, as defined in the spec.\n"
+                " --snapshot-in filename\n"
+                "         Starts from a snapshot written by --snapshot-out instead of a registration file.\n"
+                " --snapshot-out filename\n"
+                "         Writes the state to a snapshot file when the commands reach $$$ (or end).\n"
+                " --stats\n"
+                "         Prints load throughput and the time of each phase to standard error, and in a\n"
+                "         build made with 'make stats' also command latencies and engine counters.\n"
+                " --online\n"
+                "         Also answers l/r/h/s/b/p/t queries mixed into the operations, as of the latest successful place.\n"
+                " --stats-json filename\n"
+                "         Writes the same figures to a JSON file at exit.\n"
+                " --journal filename\n"
+                "         Journals every change to the state, so --recover can rebuild it after a crash.\n"
+                " --recover filename\n"
+                "         Replays a journal on top of the registration file or snapshot it was started on,\n"
+                "         then carries on with the commands on standard input and journals them too.\n"
+                " --group-commit N\n"
+                "         Makes the journal durable every N commands (default 256).\n"
+                " --archive directory\n"
+                "         Moves executed transactions out of memory into segment files in the directory.\n"
+                "         The per-account transaction lists and balance histories stay in memory, and so\n"
+                "         do the daily totals once a 't' query asks for them, so memory still grows with\n"
+                "         the history, only more slowly.\n"
+                " --pipeline\n"
+                "         Reads, executes and writes the operations on three threads that overlap.\n"
+                " --serve socket\n"
+                "         Stays running and serves commands and queries to clients on a Unix socket instead\n"
+                "         of reading standard input; every reply ends with an empty line. SIGINT or SIGTERM\n"
+                "         stops it, after which --snapshot-out and --stats apply as usual.\n"
+                " --events filename\n"
+                "         Records every placement, execution, failed execution, rejected command, login and\n"
+                "         logout as a fixed size binary record in the file (layout in engine_log.h).\n"
+                " --batch manifest\n"
+                "         Runs many independent banks in one process instead of one from --file. Each line\n"
+                "         of the manifest names a registration file, a command file and an output file; the\n"
+                "         time of every job and of the whole batch goes to standard output.\n"
+                " --jobs N\n"
+                "         Runs the --batch jobs on N threads, or a single bank's registration load, large\n"
+                "         executions and queries (default: one per hardware thread).\n"
+                " --balance-checkpoint N\n"
+                "         Keeps an absolute balance every N entries of each account's balance history, so a\n"
+                "         'b' query decodes at most N entries (default 32).\n"
                 " --help or -h\n"
                 "         Prints this input specification.\n";
                 return 0; // return from main with success
@@ -176,65 +254,201 @@ int main(int argc, char** argv) {
             }
         }
 
-        if (!file_was_set)
+        if (!batchManifest.empty())
+        {
+            if (file_was_set || !snapshotIn.empty() || !snapshotOut.empty() || !journalFile.empty() || !recoverFile.empty()
+                || !archiveDirectory.empty() || !statsJson.empty() || pipeline_was_set || !serveSocket.empty() || !eventsFile.empty()) {
+                throw "Program should receive only --verbose, --online, --jobs and --balance-checkpoint along with --batch\n";
+            }
+            return runBatch(batchManifest, jobs, verbose_was_set, online_was_set, balanceCheckpoint) ? 0 : 1;
+        }
+        if (!file_was_set && snapshotIn.empty())
         {
             throw "Program should receive a --file/-f option, followed by the name of the account registration file\n";
         }
-
-        unordered_map<string, User> users;
+        if (file_was_set && !snapshotIn.empty())
+        {
+            throw "Program should receive either a --file/-f option or a --snapshot-in option, not both\n";
+        }
+        if (!journalFile.empty() && !recoverFile.empty())
+        {
+            throw "Program should receive either a --journal option or a --recover option, not both\n";
+        }
+        if (verbose_was_set && !eventsFile.empty())
+        {
+            throw "Program should receive either a --verbose/-v option or an --events option, not both\n";
+        }
+        if (!serveSocket.empty() && pipeline_was_set)
+        {
+            throw "Program should receive either a --serve option or a --pipeline option, not both\n";
+        }
+        // a server answers queries all along, as of the latest place
+        if (!serveSocket.empty()) online_was_set = true;
+
+        BankState state;
+        ThreadPool pool(jobs);
+        DueBatch batch(pool);
+        Journal journal;
+        RunStats run;
+        if (!archiveDirectory.empty()) state.transactions.archiveTo(archiveDirectory);
         
-        // read information from filename
-        readUser(filename, users);
-
-        priority_queue<Transaction, vector<Transaction>, SortByExecuteDate> unexecutedTransactions;
-        vector<Transaction> transactions;
-        unsigned int transactionID = 0;
-        unsigned int transactionIDSuccessed = 0;
-        bool recentPlace_was_set = false;
-        uint64_t recentPlace_timestamp = UINT64_MAX;
-    
+        // read information from filename, or pick up where a snapshot left off
+        if (!snapshotIn.empty()) {
+            readSnapshot(snapshotIn, state);
+        } else {
+            auto start = chrono::steady_clock::now();
+            run.registrationBytes = readUser(filename, state.users, state.userNames, pool);
+            run.registrationMs = millisecondsSince(start);
+            run.accounts = state.users.size();
+            if (stats_was_set) {
+                double megabytes = static_cast<double>(run.registrationBytes) / 1e6;
+                cerr << "Registration: " << run.accounts << " accounts, " << megabytes << " MB in " << run.registrationMs 
+                     << " ms (" << (run.registrationMs > 0 ? megabytes * 1000 / run.registrationMs : 0) << " MB/s)\n";
+            }
+        }
 
-        string line;
-        // User commands
-        while (getline(cin, line))
-        {
-            if (!line.empty() && line[0] == '#') continue;
+        // the journal goes on from where the crashed run stopped, or starts on the state just loaded
+        if (!recoverFile.empty()) {
+            auto start = chrono::steady_clock::now();
+            uint64_t validBytes = replayJournal(recoverFile, state, balanceCheckpoint);
+            if (stats_was_set) cerr << "Recovery: " << validBytes << " journal bytes in " << millisecondsSince(start) << " ms\n";
+            journal.append(recoverFile, validBytes, groupCommit);
+        } else if (!journalFile.empty()) {
+            journal.create(journalFile, state, groupCommit);
+        }
+
+        EngineLog engineLog;
+        if (verbose_was_set) {
+            engineLog.emplace<VerboseLog>();
+        } else if (!eventsFile.empty()) {
+            engineLog.emplace<EventLog>(eventsFile);
+        }
+
+        OutputWriter output(STDOUT_FILENO);
+        CommandReader reader(STDIN_FILENO);
+        CommandFields fields;
+        string_view line;
+        bool snapshot_was_written = false;
+        auto phaseStart = chrono::steady_clock::now();
+
+        // User commands, one tokenized line at a time; false once $$$ ends them
+        auto execute = [&](string_view line, const CommandFields& fields, OutputWriter& output) {
+            if (!line.empty() && line[0] == '#') return true;
+            run.commands++;
 
             if (line == "$$$") {
-                updateToCurrentTimeStamp(users, unexecutedTransactions, transactions, transactionIDSuccessed, verbose_was_set, UINT64_MAX);
-                break;
+                // the snapshot keeps the pending transactions, so it is taken before they are all executed
+                if (!snapshotOut.empty()) {
+                    output.flush();
+                    writeSnapshot(snapshotOut, state);
+                    snapshot_was_written = true;
+                }
+                visit([&](auto& log) {
+                    updateToCurrentTimeStamp(state.users, state.userNames, state.unexecutedTransactions, state.transactions, state.transactionIDSuccessed, log, UINT64_MAX, balanceCheckpoint, batch, journal, output);
+                }, engineLog);
+                output.endCommand();
+                journal.endCommand();
+                return false;
             }
 
-            stringstream ss(line);
-            string command;
-            ss >> command;
-            if (command == "place") {   
-                place(ss, users, verbose_was_set, recentPlace_was_set, recentPlace_timestamp, unexecutedTransactions, transactions, transactionIDSuccessed, transactionID);
-            } else if (command == "login") {
-                login(ss, users, verbose_was_set);
-            } else if (command == "out") {
-                out(ss, users, verbose_was_set);
-            } else { // command == "balance"
-                balance(ss, users, verbose_was_set,recentPlace_was_set, recentPlace_timestamp);
+            visit([&](auto& log) { runCommand(fields, state, log, online_was_set, balanceCheckpoint, batch, journal, output); }, engineLog);
+            output.endCommand();
+            journal.endCommand();
+            return true;
+        };
+
+        if (!serveSocket.empty()) {
+            CommandServer server(serveSocket);
+            if (stats_was_set) cerr << "Serving on " << serveSocket << "\n";
+            auto serve = [&](string_view line, const CommandFields& fields, OutputWriter& reply) {
+                // a server has no query section to end the operations with
+                if (line[0] == '#' || line == "$$$") return;
+                run.commands++;
+                try
+                {
+                    visit([&](auto& log) { runCommand(fields, state, log, online_was_set, balanceCheckpoint, batch, journal, reply); }, engineLog);
+                }
+                catch (const char* err)
+                {
+                    // only the command is rejected, the state was not touched
+                    reply << err;
+                }
+                journal.endCommand();
+            };
+            server.run(serve, [&] {
+                journal.flush();
+                if (EventLog* events = get_if<EventLog>(&engineLog)) events->flush();
+            });
+        } else if (pipeline_was_set) {
+            CommandPipeline pipeline(reader, STDIN_FILENO, output);
+            bool running = true;
+            while (running)
+            {
+                CommandBatch* commands = pipeline.next();
+                if (commands == nullptr) break;
+                try
+                {
+                    for (size_t i = 0; i < commands->lines.size() && running; i++) {
+                        running = execute(commands->lines[i], commands->fields[i], commands->output);
+                    }
+                }
+                catch (...)
+                {
+                    // what ran before the error is still written, as without the pipeline
+                    pipeline.done(commands);
+                    throw;
+                }
+                pipeline.done(commands);
+            }
+            pipeline.finish();
+        } else {
+            while (reader.nextLine(line))
+            {
+                tokenize(line, fields);
+                if (!execute(line, fields, output)) break;
             }
         }
-
-        // Query List
-        while (getline(cin, line))
-        {
-            stringstream ss(line);
-            string command;
-            ss >> command;
-            if (command == "l") {
-                ListTransactions(ss, transactions);
-            } else if (command == "r") {
-                BankRevenue(ss, transactions);
-            } else if (command == "h") {
-                CustomerHistory(ss, transactions, users);
-            } else if (command == "s") {
-                SummarizeDay(ss, transactions);
+        journal.close();
+        if (!snapshotOut.empty() && !snapshot_was_written) {
+            output.flush();
+            writeSnapshot(snapshotOut, state);
+        }
+        output.flush();
+        run.operationsMs = millisecondsSince(phaseStart);
+        if (stats_was_set) cerr << "Operations: " << run.commands << " commands in " << run.operationsMs << " ms\n";
+        phaseStart = chrono::steady_clock::now();
+
+        // Query List, nothing changes from here on so the queries can run in parallel;
+        // a server already answered its queries and never read standard input
+        vector<string_view> queries;
+        if (serveSocket.empty()) {
+            reader.loadRemaining();
+            while (reader.nextLine(line))
+            {
+                queries.push_back(line);
             }
-        }   
+        }
+        runQueries(queries, state.transactions, state.users, state.userNames, pool, output);
+        output.flush();
+        run.queries = queries.size();
+        run.queriesMs = millisecondsSince(phaseStart);
+        if (stats_was_set) {
+            cerr << "Queries: " << run.queries << " queries in " << run.queriesMs << " ms\n";
+#ifdef BANK_STATS
+            engineStats.print(cerr);
+#endif
+        }
+        if (!statsJson.empty()) {
+            ofstream json(statsJson);
+            if (!json.is_open()) throw "Stats file failed to open.\n";
+            json << "{\n";
+            writeRunStatsJson(json, run);
+#ifdef BANK_STATS
+            json << ",\n";
+            engineStats.writeJson(json);
+#endif
+            json << "\n}\n";
+        }
     }
     catch(const char* err)
     {
@@ -244,190 +458,343 @@ int main(int argc, char** argv) {
     
 }
 
-void readUser(const string filename, unordered_map<string, User>& users){
-    ifstream regFile(filename);
+// one line of the registration file, the views point into the file contents
+struct Registration
+{
+    uint64_t registered;
+    string_view name;
+    string_view pin;
+    unsigned int balance;
+};
+
+// balance is the first whitespace separated token after the pin, read the way stoi does
+unsigned int parseBalance(string_view rest) {
+    size_t i = 0;
+    while (i < rest.size() && isFieldSpace(rest[i])) i++;
+    bool negative = false;
+    if (i < rest.size() && (rest[i] == '-' || rest[i] == '+')) negative = (rest[i++] == '-');
+    size_t digits = i;
+    int64_t value = 0;
+    while (i < rest.size() && rest[i] >= '0' && rest[i] <= '9')
+    {
+        value = value * 10 + (rest[i++] - '0');
+        if (value > INT32_MAX + int64_t(negative)) throw "Registration file has a balance out of range.\n";
+    }
+    if (i == digits) throw "Registration file has a line without a balance.\n";
+    return static_cast<unsigned int>(negative ? -value : value);
+}
+
+// Reading data assuming format: timestamp|name|Pin|balance
+void parseRegistrations(string_view text, vector<Registration>& out) {
+    size_t lines = static_cast<size_t>(count(text.begin(), text.end(), '\n')) + 1;
+    out.reserve(lines);
+    vector<string_view> timestamps;
+    timestamps.reserve(lines);
+    while (!text.empty())
+    {
+        size_t end = text.find('\n');
+        string_view line = text.substr(0, end);
+        text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+        if (line.empty()) continue;
+
+        Registration& registration = out.emplace_back();
+        size_t bar1 = line.find('|');
+        size_t bar2 = line.find('|', bar1 + 1);
+        size_t bar3 = (bar2 == string_view::npos) ? bar2 : line.find('|', bar2 + 1);
+        if (bar3 == string_view::npos) throw "Registration file has a line without a balance.\n";
+        timestamps.push_back(line.substr(0, bar1));
+        registration.name = line.substr(bar1 + 1, bar2 - bar1 - 1);
+        registration.pin = line.substr(bar2 + 1, bar3 - bar2 - 1);
+        registration.balance = parseBalance(line.substr(bar3 + 1));
+    }
+
+    // all timestamps of the chunk in one go, checked together at the end
+    vector<uint64_t> registered(timestamps.size());
+    if (!parseTimeStamps(timestamps.data(), timestamps.size(), registered.data())) {
+        throw "Timestamp is not of the form YY:MM:DD:HH:MM:SS.\n";
+    }
+    for (size_t i = 0; i < out.size(); i++) out[i].registered = registered[i];
+}
 
-    if (!regFile.is_open()) {
+// Parses the file in newline aligned chunks on the pool, then adds the
+// accounts in file order, so a repeated name is resolved the same way as a
+// line by line read: the later line replaces the account but keeps its id.
+// Returns the size of the file in bytes.
+size_t readUser(const string filename, vector<User>& users, NameTable& userNames, ThreadPool& pool){
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
         throw 
         "Error: Reading from cin has failed\n"
         "Registration file failed to open.\n";
     }
+    size_t bytes;
+    {
+        CommandReader regFile(fd);
+        regFile.loadRemaining();
+        string_view text = regFile.remaining();
+        bytes = text.size();
+
+        // small files are not worth waking the pool for
+        constexpr size_t MIN_CHUNK = 1 << 20;
+        size_t chunkCount = min<size_t>(pool.size() * 4, text.size() / MIN_CHUNK + 1);
+        vector<string_view> chunks;
+        size_t begin = 0;
+        for (size_t i = 1; i <= chunkCount && begin < text.size(); i++)
+        {
+            size_t end = text.size() * i / chunkCount;
+            if (i != chunkCount) {
+                end = text.find('\n', max(begin, end));
+                end = (end == string_view::npos) ? text.size() : end + 1;
+            }
+            chunks.push_back(text.substr(begin, end - begin));
+            begin = end;
+        }
 
-    string timestamp, name, pin, balanceStr;
-    string line;
-    while (getline(regFile, line)) {
-        stringstream ss(line);
-
-        // Reading data assuming format: timestamp|name|Pin|balance
-        getline(ss, timestamp, '|');
-        getline(ss, name, '|');
-        getline(ss, pin, '|');
-        ss >> balanceStr;
-
-        unsigned int balance = stoi(balanceStr);
+        vector<vector<Registration>> parsed(chunks.size());
+        vector<const char*> errors(chunks.size(), nullptr);
+        pool.parallelFor(chunks.size(), [&](size_t chunk) {
+            try {
+                parseRegistrations(chunks[chunk], parsed[chunk]);
+            } catch (const char* err) {
+                errors[chunk] = err; // rethrown below, not on a worker thread
+            }
+        });
+        for (const char* err : errors) {
+            if (err != nullptr) {
+                close(fd);
+                throw err;
+            }
+        }
 
-        // Insert user into the map
-        users[name] = User(balance, pin, convertTimeStamp(timestamp));
+        size_t total = 0;
+        for (const vector<Registration>& chunk : parsed) total += chunk.size();
+        users.reserve(users.size() + total);
+        userNames.reserve(userNames.size() + total);
+        for (const vector<Registration>& chunk : parsed) {
+            for (const Registration& registration : chunk) {
+                // a repeated name replaces the earlier account but keeps its id
+                auto [id, inserted] = userNames.intern(registration.name);
+                if (inserted) {
+                    users.emplace_back(registration.balance, string(registration.pin), registration.registered);
+                } else {
+                    users[id] = User(registration.balance, string(registration.pin), registration.registered);
+                }
+            }
+        }
     }
+    close(fd);
+    return bytes;
 }
 
-uint64_t convertTimeStamp(string timestamp){
-    uint64_t ans = 0;
-    ans += (timestamp[0] - '0') * 100000000000ULL;
-    ans += (timestamp[1] - '0') * 10000000000ULL;
-    ans += (timestamp[3] - '0') * 1000000000ULL;
-    ans += (timestamp[4] - '0') * 100000000ULL;
-    ans += (timestamp[6] - '0') * 10000000ULL;
-    ans += (timestamp[7] - '0') * 1000000ULL;
-    ans += (timestamp[9] - '0') * 100000ULL;
-    ans += (timestamp[10] - '0') * 10000ULL;
-    ans += (timestamp[12] - '0') * 1000ULL;
-    ans += (timestamp[13] - '0') * 100ULL;
-    ans += (timestamp[15] - '0') * 10ULL;
-    ans += (timestamp[16] - '0') * 1ULL;
-
+uint64_t convertTimeStamp(string_view timestamp){
+    uint64_t ans;
+    if (!parseTimeStamp(timestamp, ans)) throw "Timestamp is not of the form YY:MM:DD:HH:MM:SS.\n";
     return ans;
 }
 
-unsigned calculateBankFee(unsigned int amount, string feeMode, unordered_map<std::string, User>::iterator SenderIter, u_int64_t execute_ts, bool isSender) {
-    unsigned int ans = amount / 100;
-    ans = max(10u, ans);
-    ans = min(450u, ans);
-
-    // Then find if discount considered
-    if (execute_ts - SenderIter->second.reg_timestamp > 50000000000ULL)
-    {
-        ans = (ans * 3) / 4;
-    }
+// indices [first, last) of the transactions executed in [x, y)
+pair<size_t, size_t> findTransactionsInRange(const TransactionLog& transactions, uint64_t x, uint64_t y) {
+    return {transactions.lowerBound(x), transactions.lowerBound(y)};
+}
 
-    if (!isSender && feeMode == "o") {
-        ans = 0;
-    } else if (feeMode == "s") {
-        ans = (ans % 2 == 0) ? ans / 2 : (ans / 2) + (isSender ? 1 : 0);
-    } 
-    
+// a whole decimal number of dollars that fits in an unsigned int, or the command is rejected
+unsigned int parseAmount(string_view amount) {
+    unsigned int ans = 0;
+    auto [end, error] = from_chars(amount.data(), amount.data() + amount.size(), ans);
+    if (error != errc() || end != amount.data() + amount.size()) throw "Transaction amount is not a valid number.\n";
     return ans;
 }
 
-pair<vector<Transaction>::const_iterator, vector<Transaction>::const_iterator>
-findTransactionsInRange(const vector<Transaction>& transactions, uint64_t x, uint64_t y) {
-    auto startIter = lower_bound(transactions.begin(), transactions.end(), x, compareExecuteDate);
-    // the valid range should be endIt--, endIt is just fine to using end();
-    auto endIter = lower_bound(transactions.begin(), transactions.end(), y, compareExecuteDate);
-
-    return {startIter, endIter};
+FeeMode toFeeMode(string_view feeMode) {
+    // anything but the two single letter modes is charged like neither of them
+    if (feeMode == "o") return FeeMode::SENDER;
+    if (feeMode == "s") return FeeMode::SPLIT;
+    return FeeMode::BOTH;
 }
 
-string timeIntervaltoFormat(u_int64_t timeInterval) {
-    string ans;
-    vector<u_int64_t> num = {0, 0, 0, 0, 0, 0};
-    num[0] = timeInterval / 10000000000ULL;
-    timeInterval %= 10000000000ULL;
-    num[1] = timeInterval / 100000000ULL;
-    timeInterval %= 100000000ULL;
-    num[2] = timeInterval / 1000000ULL;
-    timeInterval %= 1000000ULL;
-    num[3] = timeInterval / 10000ULL;
-    timeInterval %= 10000ULL;
-    num[4] = timeInterval / 100ULL;
-    timeInterval %= 100ULL;
-    num[5] = timeInterval / 1ULL;
-    vector<string> str = {((num[0] != 1) ? "years" : "year"), ((num[1] != 1) ? "months" : "month"), ((num[2] != 1) ? "days" : "day"), ((num[3] != 1) ? "hours" : "hour"), ((num[4] != 1) ? "minutes" : "minute"), ((num[5] != 1) ? "seconds" : "second")};
+void writeTimeInterval(OutputWriter& output, u_int64_t timeInterval) {
+    static constexpr string_view UNIT_NAME[][2] = {{" year", " years"}, {" month", " months"}, {" day", " days"}, 
+                                                   {" hour", " hours"}, {" minute", " minutes"}, {" second", " seconds"}};
 
+    uint32_t num[6];
+    splitTimeStamp(timeInterval, num);
     for (size_t i = 0; i < 6; i++)
     {   
         if (num[i] == 0) continue;
-        ans += " " + to_string(num[i]) + " " + str[i];
+        output << ' ' << num[i] << UNIT_NAME[i][num[i] != 1];
     }
-    return ans;    
 }
 
-void updateToCurrentTimeStamp(unordered_map<string, User>& users, priority_queue<Transaction, vector<Transaction>, SortByExecuteDate> &unexecutedTransactions, vector<Transaction> &transactions,
-             unsigned &transactionIDSuccessed, bool& verbose_was_set, uint64_t place_timestamp) {
-    while (!unexecutedTransactions.empty() && place_timestamp >= unexecutedTransactions.top().executeDate)
-        {   
-            Transaction currentExecute = unexecutedTransactions.top(); unexecutedTransactions.pop();
-            auto sIter = users.find(currentExecute.sender);
-            auto rIter = users.find(currentExecute.recipient);
+void writeTransaction(OutputWriter& output, const TransactionLog& transactions, size_t i, const NameTable& userNames) {
+    unsigned int amount = transactions.amount(i);
+    output << transactions.transactionID(i) << ": " << userNames.name(transactions.sender(i)) << " sent " << amount 
+           << DOLLAR_TO[amount != 1] << userNames.name(transactions.recipient(i)) << " at " << transactions.executeDate(i) << ".\n";
+}
+
+// fills senderFee and recipientFee for the whole batch, a FeeBlock at a time
+void computeBatchFees(const vector<User>& users, DueBatch& batch) {
+    size_t n = batch.due.size();
+    batch.senderFee.resize(n);
+    batch.recipientFee.resize(n);
+    FeeBlock& block = batch.block;
+    for (size_t start = 0; start < n; start += FeeBlock::SIZE)
+    {
+        block.count = min(FeeBlock::SIZE, n - start);
+        for (size_t i = 0; i < block.count; i++) {
+            const Transaction& transaction = batch.due[start + i];
+            block.amount[i] = transaction.amount;
+            block.senderRegistered[i] = users[transaction.sender].reg_timestamp;
+            block.executeDate[i] = transaction.executeDate;
+            block.mode[i] = static_cast<uint32_t>(transaction.feeMode);
+        }
+        computeFees(block);
+        copy(block.senderFee, block.senderFee + block.count, batch.senderFee.begin() + static_cast<ptrdiff_t>(start));
+        copy(block.recipientFee, block.recipientFee + block.count, batch.recipientFee.begin() + static_cast<ptrdiff_t>(start));
+    }
+}
 
-            // find bank fee
-            unsigned int sfee = calculateBankFee(currentExecute.amount, currentExecute.feeMode, sIter, currentExecute.executeDate, true);
-            unsigned int rfee = calculateBankFee(currentExecute.amount, currentExecute.feeMode, sIter, currentExecute.executeDate, false);
+// applies the balance changes of one transaction if both sides can pay, bankfee is set either way
+bool settle(vector<User>& users, Transaction& currentExecute, unsigned int sfee, unsigned int rfee) {
+    User& sender = users[currentExecute.sender];
+    User& recipient = users[currentExecute.recipient];
+    currentExecute.bankfee = sfee + rfee;
 
-            // whether deal is maked
-            if (sIter->second.balance >= currentExecute.amount + sfee && rIter->second.balance >= rfee)
-            {
-                // transaction success
-                
-                // update balance
-                sIter->second.balance -= currentExecute.amount + sfee;
-                rIter->second.balance += currentExecute.amount - rfee;
-                // add index of transaction for Customer History using
-                sIter->second.outcoming.push_back(transactionIDSuccessed);
-                rIter->second.incoming.push_back(transactionIDSuccessed);
-                transactionIDSuccessed++;
-                // add transactions
-                currentExecute.bankfee = sfee + rfee;
-                transactions.push_back(currentExecute);
-                if (verbose_was_set) cout << "Transaction " << currentExecute.transactionID << " executed at " << currentExecute.executeDate << ": $" << currentExecute.amount << " from " << currentExecute.sender << " to " << currentExecute.recipient << ".\n";
-            } else {
-                if (verbose_was_set) cout << "Insufficient funds to process transaction " << currentExecute.transactionID <<".\n";
+    // whether deal is maked
+    if (sender.balance >= currentExecute.amount + sfee && recipient.balance >= rfee)
+    {
+        // update balance
+        sender.balance -= currentExecute.amount + sfee;
+        recipient.balance += currentExecute.amount - rfee;
+        return true;
+    }
+    return false;
+}
+
+// settles a large batch level by level, the transactions of a level share no account so they run in parallel
+void settleInParallel(vector<User>& users, DueBatch& batch) {
+    batch.levels.build(batch.due, users.size());
+    for (size_t level = 0; level < batch.levels.size(); level++)
+    {
+        const uint32_t* first = batch.levels.begin(level);
+        size_t count = static_cast<size_t>(batch.levels.end(level) - first);
+        auto settleRange = [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; i++) {
+                uint32_t index = first[i];
+                batch.succeeded[index] = settle(users, batch.due[index], batch.senderFee[index], batch.recipientFee[index]);
             }
+        };
+        if (count < DueBatch::PARALLEL_MIN) {
+            settleRange(0, count);
+            continue;
         }
+        constexpr size_t CHUNK = 1024;
+        batch.pool.parallelFor((count + CHUNK - 1) / CHUNK, [&](size_t chunk) {
+            settleRange(chunk * CHUNK, min(count, (chunk + 1) * CHUNK));
+        });
+    }
 }
 
-void login(stringstream& ss, unordered_map<string, User>& users, bool& verbose_was_set) {
-    string USER_ID, PIN, IP;
-    ss >> USER_ID >> PIN >> IP;
+template <typename Log>
+void updateToCurrentTimeStamp(vector<User>& users, const NameTable& userNames, CalendarQueue &unexecutedTransactions, TransactionLog &transactions,
+             unsigned &transactionIDSuccessed, Log& log, uint64_t place_timestamp, size_t balanceCheckpoint, DueBatch& batch, Journal& journal, OutputWriter& output) {
+    // numbering, history, journal and output follow the execution order
+    auto record = [&](size_t i, bool succeeded) {
+        const Transaction& done = batch.due[i];
+        if (succeeded)
+        {
+            // transaction success
+            STATS_COUNT(executed);
+            journal.executed(done.transactionID, batch.senderFee[i], batch.recipientFee[i]);
+            // add index of transaction for Customer History using
+            users[done.sender].outcoming.push_back(transactionIDSuccessed);
+            users[done.recipient].incoming.push_back(transactionIDSuccessed);
+            transactionIDSuccessed++;
+            // add transactions
+            transactions.push_back(done);
+            users[done.sender].recordBalance(done.executeDate, done.amount + batch.senderFee[i], 0, balanceCheckpoint);
+            users[done.recipient].recordBalance(done.executeDate, batch.recipientFee[i], done.amount, balanceCheckpoint);
+            log.executed(done, batch.senderFee[i], batch.recipientFee[i], userNames, output);
+        } else {
+            STATS_COUNT(insufficient_funds);
+            journal.failed(done.transactionID);
+            log.insufficientFunds(done, output);
+        }
+    };
+
+    Transaction currentExecute;
+    batch.due.clear();
+    while (unexecutedTransactions.popDue(place_timestamp, currentExecute)) batch.due.push_back(currentExecute);
+    STATS_DRAINED(batch.due.size());
+    if (batch.due.empty()) return;
+    computeBatchFees(users, batch);
+
+    // the outcomes only depend on the order of transactions within each account
+    if (batch.due.size() >= DueBatch::PARALLEL_MIN && batch.pool.size() > 1) {
+        batch.succeeded.resize(batch.due.size());
+        settleInParallel(users, batch);
+        for (size_t i = 0; i < batch.due.size(); i++) record(i, batch.succeeded[i]);
+    } else {
+        for (size_t i = 0; i < batch.due.size(); i++) {
+            record(i, settle(users, batch.due[i], batch.senderFee[i], batch.recipientFee[i]));
+        }
+    }
+}
+
+template <typename Log>
+void login(const CommandFields& fields, vector<User>& users, const NameTable& userNames, SessionStore& sessions, Log& log, Journal& journal, OutputWriter& output) {
+    string_view USER_ID = fields[1], PIN = fields[2];
 
-    if (auto iter = users.find(USER_ID); iter != users.end() && iter->second.pin == PIN)
+    uint32_t id = userNames.find(USER_ID);
+    if (id != NameTable::NOT_FOUND && users[id].pin == PIN)
     {
-        iter->second.Login(USER_ID, IP, verbose_was_set);
+        users[id].Login(USER_ID, id, sessions.intern(fields[3]), sessions, log, output);
+        journal.login(id, fields[3]);
     } else {
-        if (verbose_was_set)
-        {
-            cout << "Login failed for " << USER_ID << ".\n";
-        }
+        STATS_COUNT(login_failed);
+        log.rejected(RejectReason::LOGIN_FAILED, USER_ID, id, SessionStore::NO_KEY, output);
     }
 }
 
-void out(stringstream& ss, unordered_map<string, User>& users, bool& verbose_was_set) {
-    string USER_ID, IP;
-    ss >> USER_ID >> IP;
+template <typename Log>
+void out(const CommandFields& fields, vector<User>& users, const NameTable& userNames, SessionStore& sessions, Log& log, Journal& journal, OutputWriter& output) {
+    string_view USER_ID = fields[1];
+    uint64_t IP = sessions.find(fields[2]);
 
-    if (auto iter = users.find(USER_ID); iter != users.end())
+    uint32_t id = userNames.find(USER_ID);
+    if (id != NameTable::NOT_FOUND)
     {
-        iter->second.Logout(USER_ID, IP, verbose_was_set);
+        users[id].Logout(USER_ID, id, IP, sessions, log, output);
+        // an IP never seen cannot have been logged in, so only a known one can change anything
+        if (IP != SessionStore::NO_KEY) journal.logout(id, fields[2]);
     } else {
-        if (verbose_was_set)
-        {
-            cout << "Logout failed for " << USER_ID << ".\n";
-        }
+        STATS_COUNT(logout_failed);
+        log.rejected(RejectReason::LOGOUT_FAILED, USER_ID, id, IP, output);
     }
 }
 
-void balance(stringstream& ss, unordered_map<string, User>& users, bool& verbose_was_set, bool& recentPlace_was_set, uint64_t& recentPlace_timestamp) {
-    string ACCOUNT, IP;
-    ss >> ACCOUNT >> IP;
+template <typename Log>
+void balance(const CommandFields& fields, vector<User>& users, const NameTable& userNames, const SessionStore& sessions, Log& log, bool& recentPlace_was_set, uint64_t& recentPlace_timestamp, OutputWriter& output) {
+    string_view ACCOUNT = fields[1];
+    uint64_t IP = sessions.find(fields[2]);
 
-    if (auto iter = users.find(ACCOUNT); iter != users.end())
+    uint32_t id = userNames.find(ACCOUNT);
+    if (id != NameTable::NOT_FOUND)
     {
-        iter->second.Balance(ACCOUNT, IP, verbose_was_set, recentPlace_was_set, recentPlace_timestamp);
+        users[id].Balance(ACCOUNT, id, IP, sessions, log, recentPlace_was_set, recentPlace_timestamp, output);
     } else {
-        if (verbose_was_set)
-        {
-            cout << "Account " << ACCOUNT << " does not exist.\n";
-        }
+        STATS_COUNT(balance_unknown);
+        log.rejected(RejectReason::UNKNOWN_ACCOUNT, ACCOUNT, id, IP, output);
     }
 }
 
-void place(stringstream& ss, unordered_map<string, User>& users, bool& verbose_was_set, bool& recentPlace_was_set, uint64_t& recentPlace_timestamp, 
-            priority_queue<Transaction, vector<Transaction>, SortByExecuteDate> &unexecutedTransactions, vector<Transaction> &transactions, unsigned &transactionIDSuccessed, unsigned int& transactionID) {
-    string timestampStr, IP, SENDER, RECIPIENT, AMOUNTStr, EXEC_DATEStr, feeMode;
-    ss >> timestampStr >> IP >> SENDER>> RECIPIENT >> AMOUNTStr >> EXEC_DATEStr >> feeMode;
+template <typename Log>
+void place(const CommandFields& fields, vector<User>& users, const NameTable& userNames, const SessionStore& sessions, Log& log, bool& recentPlace_was_set, uint64_t& recentPlace_timestamp, 
+            CalendarQueue &unexecutedTransactions, TransactionLog &transactions, unsigned &transactionIDSuccessed, unsigned int& transactionID, size_t balanceCheckpoint, DueBatch& batch, Journal& journal, OutputWriter& output) {
+    string_view SENDER = fields[3], RECIPIENT = fields[4], AMOUNTStr = fields[5], feeMode = fields[7];
+    uint64_t IP = sessions.find(fields[2]);
 
-    uint64_t place_timestamp = convertTimeStamp(timestampStr);
-    uint64_t execute_timestamp = convertTimeStamp(EXEC_DATEStr);
+    uint64_t place_timestamp = convertTimeStamp(fields[1]);
+    uint64_t execute_timestamp = convertTimeStamp(fields[6]);
 
 
     // check A place command with a timestamp earlier than the previous place.
@@ -440,161 +807,568 @@ void place(stringstream& ss, unordered_map<string, User>& users, bool& verbose_w
     {
         throw "You cannot have an execution date before the current timestamp.\n";
     }
-    
-    // update recent ts for Balance using
-    if (!recentPlace_was_set) recentPlace_was_set = true;
-    recentPlace_timestamp = place_timestamp;
-    
+
+    // the checks below only read the state, so a place that passes them all
+    // can still throw on a malformed amount before anything has changed
+    uint32_t senderID = NameTable::NOT_FOUND, recipientID = NameTable::NOT_FOUND;
+    bool rejected = true;
+    RejectReason reason = RejectReason::SELF_TRANSACTION;
+
     // check The sender is different from the recipient
     if (SENDER == RECIPIENT)
     {
-        if (verbose_was_set) cout << "Self transactions are not allowed.\n";
-        return;
+        STATS_COUNT(place_self);
+        reason = RejectReason::SELF_TRANSACTION;
     }
-
     // check An execution date that’s three or less days from the timestamp of the transaction
-    if (execute_timestamp - place_timestamp > 3000000ULL)
+    else if (execute_timestamp - place_timestamp > 3000000ULL)
     {
-        if (verbose_was_set) cout << "Select a time up to three days in the future.\n";
-        return;
+        STATS_COUNT(place_too_far);
+        reason = RejectReason::TOO_FAR_AHEAD;
     }
-
     // check The sender exists (in the registration data)
-    auto senderIter = users.find(SENDER);
-    if (senderIter == users.end())
+    else if ((senderID = userNames.find(SENDER)) == NameTable::NOT_FOUND)
     {
-        if (verbose_was_set) cout << "Sender " << SENDER << " does not exist.\n";
-        return;
+        STATS_COUNT(place_unknown_sender);
+        reason = RejectReason::UNKNOWN_SENDER;
     }
-
     // check The recipient exists
-    auto recipientIter = users.find(RECIPIENT);
-    if (recipientIter == users.end())
+    else if ((recipientID = userNames.find(RECIPIENT)) == NameTable::NOT_FOUND)
     {
-        if (verbose_was_set) cout << "Recipient " << RECIPIENT << " does not exist.\n";
-        return;
+        STATS_COUNT(place_unknown_recipient);
+        reason = RejectReason::UNKNOWN_RECIPIENT;
     }
-
     // check An execution date that is later than the sender’s and recipient’s registration date (both users must have accounts already created at the execution time of the transaction)
-    if (senderIter->second.reg_timestamp > execute_timestamp || recipientIter->second.reg_timestamp > execute_timestamp)
+    else if (users[senderID].reg_timestamp > execute_timestamp || users[recipientID].reg_timestamp > execute_timestamp)
     {
-        if (verbose_was_set) cout << "At the time of execution, sender and/or recipient have not registered.\n";
-        return;
+        STATS_COUNT(place_not_registered);
+        reason = RejectReason::NOT_REGISTERED;
     }
-
     // check An active user session (i.e., the sender must be logged in, at the IP address given in the command)
-    if (senderIter->second.activeSession.empty())
+    else if (users[senderID].activeSession.empty())
     {
-        if (verbose_was_set) cout << "Sender " << SENDER << " is not logged in.\n";
-        return;
+        STATS_COUNT(place_not_logged_in);
+        reason = RejectReason::NOT_LOGGED_IN;
     }
-
     // check An active user session (i.e., the sender must be logged in, at the IP address given in the command)
-    if (senderIter->second.activeSession.find(IP) == senderIter->second.activeSession.end())
+    else if (!sessions.contains(users[senderID].activeSession, senderID, IP))
+    {
+        STATS_COUNT(place_fraud);
+        reason = RejectReason::FRAUD;
+    }
+    else
+    {
+        rejected = false;
+    }
+    unsigned int amount = rejected ? 0 : parseAmount(AMOUNTStr);
+
+    // update recent ts for Balance using
+    if (!recentPlace_was_set || recentPlace_timestamp != place_timestamp) journal.clock(place_timestamp);
+    if (!recentPlace_was_set) recentPlace_was_set = true;
+    recentPlace_timestamp = place_timestamp;
+
+    if (rejected)
     {
-        if (verbose_was_set) cout << "Fraudulent transaction detected, aborting request.\n";
+        log.placeRejected(reason, place_timestamp, execute_timestamp, SENDER, RECIPIENT, userNames, output);
         return;
-    } else {
-        // execute all transaction earlier than place_timestamp
-        updateToCurrentTimeStamp(users, unexecutedTransactions, transactions, transactionIDSuccessed, verbose_was_set, place_timestamp);
-        // add Transaction to unexecutedTransactions
-        unexecutedTransactions.push(Transaction(execute_timestamp, transactionID, stoi(AMOUNTStr), SENDER, RECIPIENT, feeMode));                   
-        if (verbose_was_set) cout << "Transaction " << transactionID << " placed at " <<  place_timestamp << ": $" << AMOUNTStr << " from " << SENDER << " to " << RECIPIENT << " at " << execute_timestamp << ".\n";
-        transactionID++;
-    } 
+    }
+    // execute all transaction earlier than place_timestamp
+    updateToCurrentTimeStamp(users, userNames, unexecutedTransactions, transactions, transactionIDSuccessed, log, place_timestamp, balanceCheckpoint, batch, journal, output);
+    // add Transaction to unexecutedTransactions
+    Transaction placed(execute_timestamp, transactionID, amount, senderID, recipientID, toFeeMode(feeMode));
+    unexecutedTransactions.push(placed);
+    journal.place(placed);
+    STATS_COUNT(place_accepted);
+    STATS_QUEUE_DEPTH(unexecutedTransactions.size());                   
+    log.placed(placed, place_timestamp, AMOUNTStr, SENDER, RECIPIENT, output);
+    transactionID++;
 }
 
-void ListTransactions(stringstream& ss, vector<Transaction> &transactions) {
+// one operation, or with --online a query, into output
+template <typename Log>
+void runCommand(const CommandFields& fields, BankState& state, Log& log, bool online_was_set, size_t balanceCheckpoint, DueBatch& batch, Journal& journal, OutputWriter& output) {
+    string_view command = fields[0];
+    if (command == "place") {   
+        STATS_TIME(PLACE);
+        place(fields, state.users, state.userNames, state.sessions, log, state.recentPlace_was_set, state.recentPlace_timestamp, state.unexecutedTransactions, state.transactions, state.transactionIDSuccessed, state.transactionID, balanceCheckpoint, batch, journal, output);
+    } else if (command == "login") {
+        STATS_TIME(LOGIN);
+        login(fields, state.users, state.userNames, state.sessions, log, journal, output);
+    } else if (command == "out") {
+        STATS_TIME(OUT);
+        out(fields, state.users, state.userNames, state.sessions, log, journal, output);
+    } else if (online_was_set && isQuery(command)) {
+        // the transactions, fee sums and history lists only ever grow at the end, so they are always ready to query
+        answerQuery(fields, state.transactions, state.users, state.userNames, output);
+    } else { // command == "balance"
+        STATS_TIME(BALANCE);
+        balance(fields, state.users, state.userNames, state.sessions, log, state.recentPlace_was_set, state.recentPlace_timestamp, output);
+    }
+}
+
+void runQueries(const vector<string_view>& queries, const TransactionLog &transactions, 
+            const vector<User>& users, const NameTable& userNames, ThreadPool& pool, OutputWriter& output) {
+    CommandFields fields;
+    if (pool.size() == 1) {
+        for (string_view query : queries) {
+            tokenize(query, fields);
+            answerQuery(fields, transactions, users, userNames, output);
+            output.endCommand();
+        }
+        return;
+    }
+
+    // answer a window of queries at a time, CHUNK queries per task into that
+    // task's own buffer, then write the buffers out in input order
+    constexpr size_t CHUNK = 64;
+    const size_t chunksPerWindow = pool.size() * 16;
+    vector<unique_ptr<OutputWriter>> buffers;
+    for (size_t i = 0; i < chunksPerWindow; i++) buffers.push_back(make_unique<OutputWriter>(-1, 1 << 16));
+    vector<const char*> errors(chunksPerWindow);
+
+    for (size_t windowStart = 0; windowStart < queries.size(); windowStart += CHUNK * chunksPerWindow)
+    {
+        size_t windowEnd = min(queries.size(), windowStart + CHUNK * chunksPerWindow);
+        size_t chunks = (windowEnd - windowStart + CHUNK - 1) / CHUNK;
+        pool.parallelFor(chunks, [&](size_t chunk) {
+            CommandFields chunkFields;
+            size_t end = min(windowEnd, windowStart + (chunk + 1) * CHUNK);
+            errors[chunk] = nullptr;
+            try {
+                for (size_t i = windowStart + chunk * CHUNK; i < end; i++) {
+                    tokenize(queries[i], chunkFields);
+                    answerQuery(chunkFields, transactions, users, userNames, *buffers[chunk]);
+                }
+            } catch (const char* err) {
+                errors[chunk] = err; // rethrown below, after the answers before it are written
+            }
+        });
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            output << buffers[chunk]->view();
+            buffers[chunk]->clear();
+            if (errors[chunk] != nullptr) throw errors[chunk];
+        }
+    }
+}
+
+bool isQuery(string_view command) {
+    return command == "l" || command == "r" || command == "h" || command == "s" || command == "b" || command == "p" || command == "t";
+}
+
+void answerQuery(const CommandFields& fields, const TransactionLog &transactions, 
+            const vector<User>& users, const NameTable& userNames, OutputWriter& output) {
+    string_view command = fields[0];
+    if (command == "l") {
+        STATS_TIME(LIST);
+        ListTransactions(fields, transactions, userNames, output);
+    } else if (command == "r") {
+        STATS_TIME(REVENUE);
+        BankRevenue(fields, transactions, output);
+    } else if (command == "h") {
+        STATS_TIME(HISTORY);
+        CustomerHistory(fields, transactions, users, userNames, output);
+    } else if (command == "s") {
+        STATS_TIME(SUMMARY);
+        SummarizeDay(fields, transactions, userNames, output);
+    } else if (command == "b") {
+        STATS_TIME(BALANCE_AS_OF);
+        BalanceAsOf(fields, users, userNames, output);
+    } else if (command == "p") {
+        STATS_TIME(HISTORY_PAGE);
+        HistoryPage(fields, transactions, users, userNames, output);
+    } else if (command == "t") {
+        STATS_TIME(TOP_ACCOUNTS);
+        TopAccounts(fields, transactions, userNames, output);
+    }
+}
+
+void ListTransactions(const CommandFields& fields, const TransactionLog &transactions, const NameTable& userNames, OutputWriter& output) {
     unsigned int transactionCount = 0;
-    string x, y;
-    ss >> x >> y;
-    u_int64_t _x = convertTimeStamp(x);
-    u_int64_t _y = convertTimeStamp(y);
+    u_int64_t _x = convertTimeStamp(fields[1]);
+    u_int64_t _y = convertTimeStamp(fields[2]);
     u_int64_t timeInterval = _y - _x;
     if (timeInterval == 0)
     {
-        cout << "List Transactions requires a non-empty time interval.\n";
+        output << "List Transactions requires a non-empty time interval.\n";
         return;
     }
 
     auto range = findTransactionsInRange(transactions, _x, _y);
-    for (auto it = range.first; it != range.second; ++it) {
-        cout << it->transactionID << ": " << it->sender << " sent " << it->amount << " " << ((it->amount != 1) ? "dollars" : "dollar") << " to " << it->recipient << " at " << it->executeDate << ".\n";
+    for (size_t i = range.first; i != range.second; ++i) {
+        writeTransaction(output, transactions, i, userNames);
         transactionCount++;
     }
-    cout << "There " << ((transactionCount != 1) ? "were" : "was") << " " << transactionCount << " " << ((transactionCount != 1) ? "transactions" : "transaction") << " that " << ((transactionCount != 1) ? "were" : "was") << " placed between time " << _x << " to " << _y << ".\n";
+    output << "There " << WAS_WERE[transactionCount != 1] << ' ' << transactionCount << TRANSACTION_THAT[transactionCount != 1] << WAS_WERE[transactionCount != 1] << " placed between time " << _x << " to " << _y << ".\n";
 }
 
-void BankRevenue(stringstream& ss, vector<Transaction> &transactions) {
+void BankRevenue(const CommandFields& fields, const TransactionLog &transactions, OutputWriter& output) {
     unsigned int bankRevenue = 0;
-    string x, y;
-    ss >> x >> y;
-    u_int64_t _x = convertTimeStamp(x);
-    u_int64_t _y = convertTimeStamp(y);
+    u_int64_t _x = convertTimeStamp(fields[1]);
+    u_int64_t _y = convertTimeStamp(fields[2]);
     u_int64_t timeInterval = _y - _x;
     if (timeInterval == 0)
     {
-        cout << "Bank Revenue requires a non-empty time interval.\n";
+        output << "Bank Revenue requires a non-empty time interval.\n";
         return;
     }
     
     auto range = findTransactionsInRange(transactions, _x, _y);
-    for (auto it = range.first; it != range.second; ++it) {
-        bankRevenue += it->bankfee;
-    }
-    cout << "281Bank has collected " << bankRevenue << " dollars in fees over" << timeIntervaltoFormat(timeInterval) << ".\n";
+    bankRevenue = transactions.feeBetween(range.first, range.second);
+    output << "281Bank has collected " << bankRevenue << " dollars in fees over";
+    writeTimeInterval(output, timeInterval);
+    output << ".\n";
 }
 
-void CustomerHistory(stringstream& ss, vector<Transaction> &transactions, unordered_map<string, User>& users) {
-    string user_id;
-    ss >> user_id;
-    if (auto iter = users.find(user_id); iter == users.end())
+void CustomerHistory(const CommandFields& fields, const TransactionLog &transactions, const vector<User>& users, const NameTable& userNames, OutputWriter& output) {
+    string_view user_id = fields[1];
+    uint32_t id = userNames.find(user_id);
+    if (id == NameTable::NOT_FOUND)
     {
-        cout << "User " << user_id << " does not exist.\n";
+        output << "User " << user_id << " does not exist.\n";
         return;
     }
-    cout << "Customer " << user_id << " account summary:\n";
-    User customer = users[user_id];
-    cout << "Balance: $" << customer.balance << "\n";
-    cout << "Total # of transactions: " << customer.incoming.size() + customer.outcoming.size() << "\n";
+    output << "Customer " << user_id << " account summary:\n";
+    const User& customer = users[id];
+    output << "Balance: $" << customer.balance << "\n";
+    output << "Total # of transactions: " << customer.incoming.size() + customer.outcoming.size() << "\n";
 
     size_t incomingSize = customer.incoming.size();
     size_t incomingStart = (incomingSize > 10) ? incomingSize - 10 : 0;
-    cout << "Incoming " << incomingSize << ":\n";
+    output << "Incoming " << incomingSize << ":\n";
     for (size_t i = incomingStart; i < incomingSize; i++) 
     {   
-        const Transaction& tempTrans = transactions[customer.incoming[i]];
-        cout << tempTrans.transactionID << ": " << tempTrans.sender << " sent " << tempTrans.amount << " " << ((tempTrans.amount != 1) ? "dollars" : "dollar") << " to " << tempTrans.recipient << " at " << tempTrans.executeDate << ".\n";
+        writeTransaction(output, transactions, customer.incoming[i], userNames);
     }
 
     size_t outgoingSize = customer.outcoming.size();
     size_t outgoingStart = (outgoingSize > 10) ? outgoingSize - 10 : 0;
-    cout << "Outgoing " << outgoingSize << ":\n";
+    output << "Outgoing " << outgoingSize << ":\n";
     for (size_t i = outgoingStart; i < outgoingSize; i++) {
-        const Transaction& tempTrans = transactions[customer.outcoming[i]];
-        cout << tempTrans.transactionID << ": " << tempTrans.sender << " sent " << tempTrans.amount << " " << ((tempTrans.amount != 1) ? "dollars" : "dollar") << " to " << tempTrans.recipient << " at " << tempTrans.executeDate << ".\n";
+        writeTransaction(output, transactions, customer.outcoming[i], userNames);
     }
 }
 
-void SummarizeDay(stringstream& ss, vector<Transaction> &transactions) {
+void SummarizeDay(const CommandFields& fields, const TransactionLog &transactions, const NameTable& userNames, OutputWriter& output) {
     unsigned int transactionCount = 0;
     unsigned int bankRevenue = 0;
-    string x;
-    ss >> x;
-    u_int64_t _x = convertTimeStamp(x);
+    u_int64_t _x = convertTimeStamp(fields[1]);
 
     // find the day timestamp
     _x = (_x / 1000000ULL) * 1000000ULL;
     u_int64_t _y = _x + 1000000ULL;
-    cout << "Summary of [" << _x << ", " << _y << "):\n";
+    output << "Summary of [" << _x << ", " << _y << "):\n";
 
     auto range = findTransactionsInRange(transactions, _x, _y);
-    for (auto it = range.first; it != range.second; ++it) {
-        cout << it->transactionID << ": " << it->sender << " sent " << it->amount << " " << ((it->amount != 1) ? "dollars" : "dollar") << " to " << it->recipient << " at " << it->executeDate << ".\n";
-        transactionCount++;
-        bankRevenue += it->bankfee;
+    for (size_t i = range.first; i != range.second; ++i) {
+        writeTransaction(output, transactions, i, userNames);
+    }
+    transactionCount = static_cast<unsigned int>(range.second - range.first);
+    bankRevenue = transactions.feeBetween(range.first, range.second);
+    output << "There " << WAS_WERE[transactionCount != 1] << " a total of " << transactionCount << TRANSACTION_COMMA[transactionCount != 1] << "281Bank has collected " << bankRevenue << " dollars in fees.\n";
+}
+
+void BalanceAsOf(const CommandFields& fields, const vector<User>& users, const NameTable& userNames, OutputWriter& output) {
+    string_view user_id = fields[1];
+    uint32_t id = userNames.find(user_id);
+    if (id == NameTable::NOT_FOUND)
+    {
+        output << "User " << user_id << " does not exist.\n";
+        return;
+    }
+    u_int64_t _x = convertTimeStamp(fields[2]);
+    unsigned int balanceAsOf;
+    if (!users[id].history.balanceAt(_x, balanceAsOf))
+    {
+        output << "Account " << user_id << " was not registered as of " << _x << ".\n";
+        return;
+    }
+    output << "As of " << _x << ", " << user_id << " had a balance of $" << balanceAsOf << ".\n";
+}
+
+// false unless text is a whole decimal number that fits
+bool parseCount(string_view text, unsigned int& value) {
+    auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    return error == errc() && end == text.data() + text.size();
+}
+
+// p <account> <cursor> <page size>: the account's transactions in execution
+// order, page size of them from transaction index cursor on. Both history
+// lists are sorted by index, so the page is a merge of the two from where a
+// binary search puts the cursor, and costs the page, not the history.
+void HistoryPage(const CommandFields& fields, const TransactionLog &transactions, const vector<User>& users, const NameTable& userNames, OutputWriter& output) {
+    string_view user_id = fields[1];
+    unsigned int cursor, pageSize;
+    if (!parseCount(fields[2], cursor)) throw "History cursor is not a number.\n";
+    if (!parseCount(fields[3], pageSize) || pageSize == 0) throw "History page size is not a positive number.\n";
+    uint32_t id = userNames.find(user_id);
+    if (id == NameTable::NOT_FOUND)
+    {
+        output << "User " << user_id << " does not exist.\n";
+        return;
+    }
+    const vector<unsigned int>& incoming = users[id].incoming;
+    const vector<unsigned int>& outgoing = users[id].outcoming;
+    auto in = lower_bound(incoming.begin(), incoming.end(), cursor);
+    auto out = lower_bound(outgoing.begin(), outgoing.end(), cursor);
+    output << "Customer " << user_id << " history from " << cursor << ":\n";
+    for (unsigned int shown = 0; shown < pageSize && (in != incoming.end() || out != outgoing.end()); shown++)
+    {
+        // an account is never both sides of a transaction, so the two lists never share an index
+        bool takeIncoming = (out == outgoing.end()) || (in != incoming.end() && *in < *out);
+        unsigned int index = takeIncoming ? *in++ : *out++;
+        writeTransaction(output, transactions, index, userNames);
+        cursor = index + 1;
+    }
+    if (in == incoming.end() && out == outgoing.end()) {
+        output << "End of history, next cursor: " << cursor << ".\n";
+    } else {
+        output << "Next cursor: " << cursor << ".\n";
+    }
+}
+
+// t <sent|received|fees> <count> <x> <y>: the count accounts that sent,
+// received or paid in fees the most over the transactions executed in
+// [x, y), the largest first and ties by account id. The whole days inside
+// the range are read from the log's daily totals, so only the partial days
+// at either end are walked transaction by transaction, and a heap of count
+// accounts keeps the leaders.
+void TopAccounts(const CommandFields& fields, const TransactionLog &transactions, const NameTable& userNames, OutputWriter& output) {
+    constexpr const char* MEASURES[3] = {"sent", "received", "fees"};
+    constexpr const char* TITLES[3] = {"sent volume", "received volume", "fees paid"};
+    constexpr const char* VERBS[3] = {" sent $", " received $", " paid $"};
+    size_t measure = static_cast<size_t>(find(MEASURES, MEASURES + 3, fields[1]) - MEASURES);
+    if (measure == 3) throw "Top accounts are ranked by sent, received or fees.\n";
+    unsigned int count;
+    if (!parseCount(fields[2], count) || count == 0) throw "Top accounts count is not a positive number.\n";
+    u_int64_t _x = convertTimeStamp(fields[3]);
+    u_int64_t _y = convertTimeStamp(fields[4]);
+    if (_y <= _x)
+    {
+        output << "Top accounts requires a non-empty time interval.\n";
+        return;
+    }
+
+    unordered_map<uint32_t, uint64_t> totals;
+    auto credit = [&totals, measure](uint32_t account, uint64_t sent, uint64_t received, uint64_t fees) {
+        uint64_t value = (measure == 0) ? sent : (measure == 1) ? received : fees;
+        if (value != 0) totals[account] += value;
+    };
+    auto walk = [&](uint64_t from, uint64_t to) {
+        auto range = findTransactionsInRange(transactions, from, to);
+        for (size_t i = range.first; i < range.second; ++i) {
+            unsigned senderFee, recipientFee;
+            splitBankFee(transactions.bankfee(i), transactions.feeMode(i), senderFee, recipientFee);
+            credit(transactions.sender(i), transactions.amount(i), 0, senderFee);
+            credit(transactions.recipient(i), 0, transactions.amount(i), recipientFee);
+        }
+    };
+    const uint64_t DAY = DailyTotals::DAY;
+    uint64_t firstDay = (_x + DAY - 1) / DAY;
+    uint64_t lastDay = _y / DAY;
+    if (firstDay < lastDay) {
+        walk(_x, firstDay * DAY);
+        transactions.dailyTotals().forEachTotal(firstDay, lastDay, [&credit](const DayTotal& total) {
+            credit(total.account, total.sent, total.received, total.fees);
+        });
+        walk(lastDay * DAY, _y);
+    } else {
+        walk(_x, _y);
+    }
+
+    // the top of the heap is the weakest of the leaders so far
+    using Leader = pair<uint64_t, uint32_t>;
+    auto ahead = [](const Leader& left, const Leader& right) {
+        return left.first > right.first || (left.first == right.first && left.second < right.second);
+    };
+    priority_queue<Leader, vector<Leader>, decltype(ahead)> leaders(ahead);
+    for (const auto& entry : totals) {
+        Leader candidate(entry.second, entry.first);
+        if (leaders.size() < count) {
+            leaders.push(candidate);
+        } else if (ahead(candidate, leaders.top())) {
+            leaders.pop();
+            leaders.push(candidate);
+        }
+    }
+    vector<Leader> ranked(leaders.size());
+    for (size_t i = ranked.size(); i > 0; i--) {
+        ranked[i - 1] = leaders.top();
+        leaders.pop();
+    }
+
+    output << "Top " << count << (count != 1 ? " accounts by " : " account by ") << TITLES[measure] << " between time " << _x << " to " << _y << ":\n";
+    for (size_t i = 0; i < ranked.size(); i++) {
+        output << i + 1 << ". " << userNames.name(ranked[i].second) << VERBS[measure] << ranked[i].first << (measure == 2 ? " in fees.\n" : ".\n");
+    }
+}
+
+// One bank of a --batch run, and how it went.
+struct BatchJob
+{
+    string registrations;
+    string commands;
+    string output;
+    uint64_t bytes = 0; // of both input files, the larger jobs start first
+    unsigned worker = 0;
+    size_t accounts = 0;
+    size_t operations = 0;
+    size_t queries = 0;
+    double registrationMs = 0;
+    double operationsMs = 0;
+    double queriesMs = 0;
+    const char* error = nullptr;
+};
+
+// What a --batch thread keeps from one job to the next. The containers of
+// the bank and of its execution batch are cleared between jobs but keep
+// their capacity, so after the first few jobs a thread hardly allocates.
+struct BatchWorker
+{
+    ThreadPool pool{1}; // the jobs are what runs in parallel, each one on a single thread
+    BankState state;
+    DueBatch batch{pool};
+    Journal journal; // never opened
+    vector<string_view> queries;
+    STATS_ONLY(EngineStats stats;) // what the jobs of this thread record, apart from the other threads
+};
+
+// Each line is a registration file, a command file and an output file;
+// empty lines and lines starting with # are skipped.
+vector<BatchJob> readManifest(const string& manifest) {
+    ifstream file(manifest);
+    if (!file.is_open()) throw "Manifest file failed to open.\n";
+    vector<BatchJob> jobs;
+    string line;
+    while (getline(file, line))
+    {
+        istringstream fields(line);
+        BatchJob job;
+        if (!(fields >> job.registrations) || job.registrations[0] == '#') continue;
+        string extra;
+        if (!(fields >> job.commands >> job.output) || (fields >> extra)) {
+            throw "Manifest lines should each name a registration file, a command file and an output file.\n";
+        }
+        struct stat st;
+        if (stat(job.registrations.c_str(), &st) == 0) job.bytes += static_cast<uint64_t>(st.st_size);
+        if (stat(job.commands.c_str(), &st) == 0) job.bytes += static_cast<uint64_t>(st.st_size);
+        jobs.push_back(move(job));
+    }
+    return jobs;
+}
+
+// the same as a bank run with --file on the job's files, into its output file
+void runJob(BatchJob& job, BatchWorker& worker, bool verbose_was_set, bool online_was_set, size_t balanceCheckpoint) {
+    BankState& state = worker.state;
+    state.clear();
+    STATS_ONLY(threadStats = &worker.stats;)
+    auto start = chrono::steady_clock::now();
+    readUser(job.registrations, state.users, state.userNames, worker.pool);
+    job.accounts = state.users.size();
+    job.registrationMs = millisecondsSince(start);
+
+    int in = open(job.commands.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) throw "Command file failed to open.\n";
+    int out = open(job.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        close(in);
+        throw "Output file failed to open.\n";
+    }
+    EngineLog log;
+    if (verbose_was_set) log.emplace<VerboseLog>();
+    const char* error = nullptr;
+    {
+        CommandReader reader(in);
+        OutputWriter output(out);
+        try
+        {
+            start = chrono::steady_clock::now();
+            CommandFields fields;
+            string_view line;
+            while (reader.nextLine(line))
+            {
+                if (!line.empty() && line[0] == '#') continue;
+                if (line == "$$$") {
+                    visit([&](auto& log) {
+                        updateToCurrentTimeStamp(state.users, state.userNames, state.unexecutedTransactions, state.transactions, state.transactionIDSuccessed, log, UINT64_MAX, balanceCheckpoint, worker.batch, worker.journal, output);
+                    }, log);
+                    break;
+                }
+                job.operations++;
+                tokenize(line, fields);
+                visit([&](auto& log) { runCommand(fields, state, log, online_was_set, balanceCheckpoint, worker.batch, worker.journal, output); }, log);
+            }
+            job.operationsMs = millisecondsSince(start);
+
+            start = chrono::steady_clock::now();
+            reader.loadRemaining();
+            worker.queries.clear();
+            while (reader.nextLine(line))
+            {
+                worker.queries.push_back(line);
+            }
+            runQueries(worker.queries, state.transactions, state.users, state.userNames, worker.pool, output);
+            job.queries = worker.queries.size();
+            job.queriesMs = millisecondsSince(start);
+        }
+        catch (const char* err)
+        {
+            // what ran before the error is still written, as in a single run
+            error = err;
+        }
+    }
+    close(in);
+    close(out);
+    if (error != nullptr) throw error;
+}
+
+// Runs every job of the manifest, largest first, and reports each of them
+// and the whole batch on standard output. False if any job failed.
+bool runBatch(const string& manifest, unsigned threads, bool verbose_was_set, bool online_was_set, size_t balanceCheckpoint) {
+    vector<BatchJob> jobs = readManifest(manifest);
+    vector<size_t> order(jobs.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&jobs](size_t left, size_t right) { return jobs[left].bytes > jobs[right].bytes; });
+
+    WorkStealingPool pool(static_cast<unsigned>(min<size_t>(threads, max<size_t>(jobs.size(), 1))));
+    vector<unique_ptr<BatchWorker>> workers(pool.size());
+    for (unique_ptr<BatchWorker>& worker : workers) worker = make_unique<BatchWorker>();
+    auto start = chrono::steady_clock::now();
+    pool.run(order, [&](unsigned worker, size_t i) {
+        BatchJob& job = jobs[i];
+        job.worker = worker;
+        try
+        {
+            runJob(job, *workers[worker], verbose_was_set, online_was_set, balanceCheckpoint);
+        }
+        catch (const char* err)
+        {
+            job.error = err;
+        }
+    });
+    double wallMs = millisecondsSince(start);
+
+    size_t failed = 0;
+    double jobMs = 0;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const BatchJob& job = jobs[i];
+        double totalMs = job.registrationMs + job.operationsMs + job.queriesMs;
+        jobMs += totalMs;
+        cout << "Job " << i << " (" << job.registrations << ", " << job.commands << " -> " << job.output << ") ";
+        if (job.error != nullptr) {
+            failed++;
+            string_view message(job.error);
+            while (!message.empty() && message.back() == '\n') message.remove_suffix(1);
+            cout << "failed on thread " << job.worker << ": " << message << "\n";
+            continue;
+        }
+        cout << "on thread " << job.worker << ": " << job.accounts << " accounts, " << job.operations << " operations, "
+             << job.queries << " queries in " << totalMs << " ms (registration " << job.registrationMs << ", operations "
+             << job.operationsMs << ", queries " << job.queriesMs << ")\n";
     }
-    cout << "There " << ((transactionCount != 1) ? "were" : "was") << " a total of " << transactionCount << " " << ((transactionCount != 1) ? "transactions" : "transaction") << ", 281Bank has collected " << bankRevenue << " dollars in fees.\n";
+    cout << "Batch: " << jobs.size() << " jobs, " << failed << " failed, on " << pool.size() << " threads in " << wallMs
+         << " ms (" << jobMs << " ms of job time, " << (wallMs > 0 ? static_cast<double>(jobs.size()) * 1000 / wallMs : 0) << " jobs/s)\n";
+    return failed == 0;
 }
     
 
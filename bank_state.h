@@ -0,0 +1,41 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef BANK_STATE_H
+#define BANK_STATE_H
+
+#include <cstdint>
+#include <vector>
+#include "name_table.h"
+#include "scheduler.h"
+#include "session_store.h"
+#include "transaction.h"
+#include "transaction_log.h"
+#include "user.h"
+
+// Everything the command loop changes, i.e. what a snapshot has to carry.
+struct BankState
+{
+    std::vector<User> users; // indexed by account id
+    NameTable userNames;
+    SessionStore sessions;
+    CalendarQueue unexecutedTransactions;
+    TransactionLog transactions; // executed, in execution order
+    unsigned int transactionID = 0;
+    unsigned int transactionIDSuccessed = 0;
+    bool recentPlace_was_set = false;
+    uint64_t recentPlace_timestamp = UINT64_MAX;
+
+    // back to a bank without accounts, for running another one on the same storage
+    void clear() {
+        users.clear();
+        userNames.clear();
+        sessions.clear();
+        unexecutedTransactions.clear();
+        transactions.clear();
+        transactionID = 0;
+        transactionIDSuccessed = 0;
+        recentPlace_was_set = false;
+        recentPlace_timestamp = UINT64_MAX;
+    }
+};
+
+#endif
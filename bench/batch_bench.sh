@@ -0,0 +1,70 @@
+#!/bin/sh
+# Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+# Measures what --batch saves over one process per bank: the wall time of
+# many small banks run one process after another, then as a single --batch
+# run with each number of threads given.
+#
+# The banks are generated once by workload_gen into bench/data/batch, each
+# with its own seed; the outputs of both ways are compared before timing
+# counts for anything.
+#
+# usage: batch_bench.sh <bank> <workload_gen> [banks, default 200] [threads ...]
+set -e
+
+BANK=$1
+GEN=$2
+BANKS=${3:-200}
+shift 2
+[ $# -gt 0 ] && shift
+DATA=bench/data/batch
+mkdir -p "$DATA"
+
+if [ $# -eq 0 ]; then
+    set -- 1
+    [ "$(nproc)" -gt 1 ] && set -- 1 "$(nproc)"
+fi
+
+options="--users 500 --commands 2000 --queries 100"
+if [ "$(cat "$DATA/banks" 2>/dev/null)" != "$BANKS $options" ] || [ "$GEN" -nt "$DATA/banks" ]; then
+    echo "generating $BANKS banks" >&2
+    i=0
+    while [ "$i" -lt "$BANKS" ]; do
+        # shellcheck disable=SC2086
+        "$GEN" $options --seed "$((i + 1))" "$DATA/bank$i" > /dev/null
+        i=$((i + 1))
+    done
+    echo "$BANKS $options" > "$DATA/banks"
+fi
+
+i=0
+: > "$DATA/manifest"
+while [ "$i" -lt "$BANKS" ]; do
+    echo "$DATA/bank$i-reg.txt $DATA/bank$i-commands.txt $DATA/bank$i-batch.out" >> "$DATA/manifest"
+    i=$((i + 1))
+done
+
+milliseconds() {
+    echo $(($(date +%s%N) / 1000000))
+}
+
+start=$(milliseconds)
+i=0
+while [ "$i" -lt "$BANKS" ]; do
+    "$BANK" -f "$DATA/bank$i-reg.txt" < "$DATA/bank$i-commands.txt" > "$DATA/bank$i-single.out"
+    i=$((i + 1))
+done
+single=$(($(milliseconds) - start))
+printf "%-20s %8d ms %10.1f banks/s\n" "one process each" "$single" "$(echo "$BANKS $single" | awk '{ print $1 * 1000 / $2 }')"
+
+for threads in "$@"; do
+    start=$(milliseconds)
+    "$BANK" --batch "$DATA/manifest" --jobs "$threads" > "$DATA/report.txt"
+    batch=$(($(milliseconds) - start))
+    i=0
+    while [ "$i" -lt "$BANKS" ]; do
+        cmp -s "$DATA/bank$i-single.out" "$DATA/bank$i-batch.out" || { echo "bank $i differs" >&2; exit 1; }
+        i=$((i + 1))
+    done
+    printf "%-20s %8d ms %10.1f banks/s\n" "--batch, $threads threads" "$batch" "$(echo "$BANKS $batch" | awk '{ print $1 * 1000 / $2 }')"
+done
+rm -f "$DATA"/*-single.out "$DATA"/*-batch.out
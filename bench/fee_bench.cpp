@@ -0,0 +1,128 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+// Times the FeeBlock fee kernel against two calculateBankFee() calls per
+// transaction, the way the drain used to compute fees.
+//
+// The transactions are random but cover every branch: amounts around both
+// clamps, all three fee modes, and senders on both sides of the loyalty
+// period. Both paths must produce the same fees, and the kernel is also
+// checked against the scalar rules over a grid of edge cases.
+//
+// usage: bench_fee [transaction count, default 10000000] [rounds, default 10]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../fee.h"
+
+using namespace std;
+
+struct Due {
+    Transaction transaction;
+    uint64_t senderRegistered;
+};
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+uint64_t scalar(const vector<Due>& batch, vector<uint32_t>& senderFee, vector<uint32_t>& recipientFee) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        const Transaction& t = batch[i].transaction;
+        senderFee[i] = calculateBankFee(t.amount, t.feeMode, batch[i].senderRegistered, t.executeDate, true);
+        recipientFee[i] = calculateBankFee(t.amount, t.feeMode, batch[i].senderRegistered, t.executeDate, false);
+        sum += senderFee[i] + recipientFee[i];
+    }
+    return sum;
+}
+
+// gathers each block into columns first, as the drain does
+uint64_t kernel(const vector<Due>& batch, FeeBlock& block, vector<uint32_t>& senderFee, vector<uint32_t>& recipientFee) {
+    uint64_t sum = 0;
+    for (size_t start = 0; start < batch.size(); start += FeeBlock::SIZE) {
+        block.count = min(FeeBlock::SIZE, batch.size() - start);
+        for (size_t i = 0; i < block.count; i++) {
+            const Due& due = batch[start + i];
+            block.amount[i] = due.transaction.amount;
+            block.senderRegistered[i] = due.senderRegistered;
+            block.executeDate[i] = due.transaction.executeDate;
+            block.mode[i] = static_cast<uint32_t>(due.transaction.feeMode);
+        }
+        computeFees(block);
+        for (size_t i = 0; i < block.count; i++) {
+            senderFee[start + i] = block.senderFee[i];
+            recipientFee[start + i] = block.recipientFee[i];
+            sum += block.senderFee[i] + block.recipientFee[i];
+        }
+    }
+    return sum;
+}
+
+bool checkEdgeCases() {
+    FeeBlock block;
+    const unsigned amounts[] = {0, 1, 999, 1000, 1001, 1099, 1100, 1299, 44999, 45000, 45099, 45100, 4000000000u};
+    const uint64_t ages[] = {0, LOYALTY_PERIOD - 1, LOYALTY_PERIOD, LOYALTY_PERIOD + 1, 99999999999ULL};
+    const FeeMode modes[] = {FeeMode::BOTH, FeeMode::SENDER, FeeMode::SPLIT};
+    for (unsigned amount : amounts) {
+        for (uint64_t age : ages) {
+            block.count = 0;
+            for (FeeMode mode : modes) {
+                block.amount[block.count] = amount;
+                block.senderRegistered[block.count] = 10000000000ULL;
+                block.executeDate[block.count] = 10000000000ULL + age;
+                block.mode[block.count] = static_cast<uint32_t>(mode);
+                block.count++;
+            }
+            computeFees(block);
+            for (size_t i = 0; i < block.count; i++) {
+                uint64_t execute = block.executeDate[i];
+                if (block.senderFee[i] != calculateBankFee(amount, modes[i], 10000000000ULL, execute, true)
+                    || block.recipientFee[i] != calculateBankFee(amount, modes[i], 10000000000ULL, execute, false)) {
+                    printf("mismatch at amount %u, age %llu, mode %zu\n", amount, static_cast<unsigned long long>(age), i);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t count = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 10000000;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 10;
+    if (!checkEdgeCases()) return 1;
+
+    mt19937_64 rng(281);
+    vector<Due> batch(count);
+    for (size_t i = 0; i < count; i++) {
+        unsigned amount = static_cast<unsigned>(rng() % 4 == 0 ? rng() % 100000 : rng() % 3000);
+        uint64_t execute = 80000000000ULL + rng() % 10000000000ULL;
+        uint64_t registered = execute - rng() % (2 * LOYALTY_PERIOD);
+        batch[i] = {Transaction(execute, static_cast<unsigned>(i), amount, 0, 1, static_cast<FeeMode>(rng() % 3)), registered};
+    }
+
+    vector<uint32_t> scalarSender(count), scalarRecipient(count), kernelSender(count), kernelRecipient(count);
+    FeeBlock block;
+    double scalarTime = 1e300, kernelTime = 1e300;
+    uint64_t scalarSum = 0, kernelSum = 0;
+    for (int round = 0; round < rounds; round++) {
+        auto start = chrono::steady_clock::now();
+        scalarSum = scalar(batch, scalarSender, scalarRecipient);
+        scalarTime = min(scalarTime, secondsSince(start));
+
+        start = chrono::steady_clock::now();
+        kernelSum = kernel(batch, block, kernelSender, kernelRecipient);
+        kernelTime = min(kernelTime, secondsSince(start));
+    }
+
+    printf("%zu transactions, best of %d rounds\n", count, rounds);
+    printf("calculateBankFee x2  %8.3f ms  %6.2f ns/transaction\n", scalarTime * 1e3, scalarTime * 1e9 / static_cast<double>(count));
+    printf("computeFees          %8.3f ms  %6.2f ns/transaction\n", kernelTime * 1e3, kernelTime * 1e9 / static_cast<double>(count));
+    if (scalarSum != kernelSum || scalarSender != kernelSender || scalarRecipient != kernelRecipient) {
+        printf("fees differ\n");
+        return 1;
+    }
+    printf("speedup %.2fx, identical fees\n", scalarTime / kernelTime);
+    return 0;
+}
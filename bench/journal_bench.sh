@@ -0,0 +1,50 @@
+#!/bin/sh
+# Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+# Measures what the journal costs: commands per second of the operations
+# phase without a journal and with --group-commit at each interval given.
+#
+# The workload is generated once by workload_gen into bench/data. The
+# journal goes to JOURNAL_DIR (default bench/data); fsync cost depends on
+# the disk under it, so point it at the disk that matters.
+#
+# usage: journal_bench.sh <bank> <workload_gen> [interval ...]
+set -e
+
+BANK=$1
+GEN=$2
+shift 2
+DATA=bench/data
+JOURNAL_DIR=${JOURNAL_DIR:-$DATA}
+mkdir -p "$DATA" "$JOURNAL_DIR"
+
+if [ $# -eq 0 ]; then
+    set -- 1 16 256 4096
+fi
+
+options="--users 10000 --commands 200000 --queries 0 --seed 5"
+prefix=$DATA/journal
+if [ ! -f "$prefix-commands.txt" ] || [ "$GEN" -nt "$prefix-commands.txt" ] \
+    || [ "$(cat "$prefix.options" 2>/dev/null)" != "$options" ]; then
+    echo "generating journal workload" >&2
+    # shellcheck disable=SC2086
+    "$GEN" $options "$prefix"
+    echo "$options" > "$prefix.options"
+fi
+
+# prints "<commands> <ms>" from the Operations line of --stats
+operations() {
+    awk '$1 == "Operations:" { print $2, $5 }' "$1"
+}
+
+run() {
+    "$BANK" --stats -f "$prefix-reg.txt" "$@" < "$prefix-commands.txt" > /dev/null 2> "$prefix-stats.txt"
+    operations "$prefix-stats.txt" | awk -v name="$label" '{ printf "%-16s %10d commands %10.1f ms %12.0f commands/s\n", name, $1, $2, $1 * 1000 / $2 }'
+}
+
+label="no journal"
+run
+for interval in "$@"; do
+    label="group $interval"
+    run --journal "$JOURNAL_DIR/bench.wal" --group-commit "$interval"
+done
+rm -f "$JOURNAL_DIR/bench.wal"
@@ -0,0 +1,85 @@
+#!/bin/sh
+# Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+# Times bank on fixed synthetic workloads and writes the results as JSON.
+#
+# Every workload is generated once by workload_gen with a fixed seed into
+# bench/data, then bank runs it BENCH_RUNS times (default 3) with --stats;
+# the fastest time of each phase is kept.
+#
+# usage: run_bench.sh <bank> <workload_gen> <results.json> [workload ...]
+set -e
+
+BANK=$1
+GEN=$2
+RESULTS=$3
+shift 3
+RUNS=${BENCH_RUNS:-3}
+DATA=bench/data
+mkdir -p "$DATA"
+
+# name, then workload_gen options
+workload() {
+    case $1 in
+    small)   echo "--users 10000 --commands 100000 --queries 10000 --seed 1" ;;
+    large)   echo "--users 1000000 --commands 2000000 --queries 100000 --seed 2" ;;
+    queries) echo "--users 100000 --commands 200000 --queries 500000 --mix 1,1,4,1 --seed 3" ;;
+    churn)   echo "--users 100000 --commands 1000000 --queries 1000 --place-rate 0.2 --churn 0.7 --invalid 0.2 --seed 4" ;;
+    *)       echo "unknown workload $1" >&2; exit 1 ;;
+    esac
+}
+
+if [ $# -eq 0 ]; then
+    set -- small large queries churn
+fi
+
+# the value in front of the word after the label on the --stats line, e.g. "ms"
+stat() {
+    awk -v label="$2" -v unit="$3" '$1 == label { for (i = 2; i <= NF; i++) if ($i == unit) { print $(i - 1); exit } }' "$1"
+}
+
+min() {
+    awk -v a="$1" -v b="$2" 'BEGIN { if (a == "" || b + 0 < a + 0) print b; else print a }'
+}
+
+now_ns() {
+    date +%s%N
+}
+
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+{
+    printf '{\n  "commit": "%s",\n  "date": "%s",\n  "runs": %s,\n  "workloads": [' "$COMMIT" "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$RUNS"
+    first=1
+    for name in "$@"; do
+        options=$(workload "$name")
+        prefix=$DATA/$name
+        # regenerate when the options of a workload or the generator change
+        if [ ! -f "$prefix-commands.txt" ] || [ "$GEN" -nt "$prefix-commands.txt" ] \
+            || [ "$(cat "$prefix.options" 2>/dev/null)" != "$options" ]; then
+            echo "generating $name" >&2
+            # shellcheck disable=SC2086
+            "$GEN" $options "$prefix"
+            echo "$options" > "$prefix.options"
+        fi
+
+        registration=""; operations=""; queries=""; total=""
+        run=0
+        while [ $run -lt "$RUNS" ]; do
+            start=$(now_ns)
+            "$BANK" --stats -f "$prefix-reg.txt" < "$prefix-commands.txt" > /dev/null 2> "$prefix-stats.txt"
+            end=$(now_ns)
+            registration=$(min "$registration" "$(stat "$prefix-stats.txt" Registration: ms)")
+            operations=$(min "$operations" "$(stat "$prefix-stats.txt" Operations: ms)")
+            queries=$(min "$queries" "$(stat "$prefix-stats.txt" Queries: ms)")
+            total=$(min "$total" "$(awk -v s="$start" -v e="$end" 'BEGIN { print (e - s) / 1000000 }')")
+            run=$((run + 1))
+        done
+        echo "$name: registration $registration ms, operations $operations ms, queries $queries ms, total $total ms" >&2
+
+        [ $first -eq 1 ] || printf ','
+        first=0
+        printf '\n    {"name": "%s", "options": "%s", "registration_ms": %s, "operations_ms": %s, "queries_ms": %s, "total_ms": %s}' \
+            "$name" "$options" "$registration" "$operations" "$queries" "$total"
+    done
+    printf '\n  ]\n}\n'
+} > "$RESULTS"
+echo "results written to $RESULTS" >&2
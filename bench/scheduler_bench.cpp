@@ -0,0 +1,109 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+// Times the CalendarQueue scheduler against the priority_queue it replaced.
+//
+// The workload follows what place() produces: placement timestamps never
+// decrease and every execution date is at most 3000000 past its placement.
+// Phase 1 fills the queue with N pending transactions, phase 2 runs N
+// place-like steps (drain everything due, push one), phase 3 drains the rest
+// the way $$$ does. Both queues must hand out the same order.
+//
+// usage: bench_scheduler [pending count, default 10000000]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <vector>
+#include "../scheduler.h"
+
+using namespace std;
+
+struct Step {
+    uint64_t placeDate;
+    uint64_t executeDate;
+};
+
+struct Result {
+    double fill, steady, drain;
+    uint64_t checksum;
+};
+
+class HeapQueue {
+public:
+    void push(const Transaction& transaction) { heap.push(transaction); }
+    bool popDue(uint64_t timestamp, Transaction& out) {
+        if (heap.empty() || heap.top().executeDate > timestamp) return false;
+        out = heap.top();
+        heap.pop();
+        return true;
+    }
+private:
+    priority_queue<Transaction, vector<Transaction>, SortByExecuteDate> heap;
+};
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+template <typename Queue>
+Result run(const vector<Step>& steps, size_t pending) {
+    Result result{};
+    Queue queue;
+    Transaction due;
+    unsigned id = 0;
+    // order sensitive hash of the drained ids
+    auto consume = [&](const Transaction& t) { result.checksum = result.checksum * 1000003ULL + t.transactionID; };
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < pending; i++, id++) {
+        queue.push(Transaction(steps[i].executeDate, id, 100, 0, 1, FeeMode::SENDER));
+    }
+    result.fill = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    for (size_t i = pending; i < steps.size(); i++, id++) {
+        while (queue.popDue(steps[i].placeDate, due)) consume(due);
+        queue.push(Transaction(steps[i].executeDate, id, 100, 0, 1, FeeMode::SENDER));
+    }
+    result.steady = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    while (queue.popDue(UINT64_MAX, due)) consume(due);
+    result.drain = secondsSince(start);
+    return result;
+}
+
+void report(const char* name, const Result& result, size_t pending) {
+    double total = result.fill + result.steady + result.drain;
+    printf("%-14s fill %7.3fs  steady %7.3fs  drain %7.3fs  total %7.3fs  %6.1f ns/op\n",
+           name, result.fill, result.steady, result.drain, total, total * 1e9 / (3.0 * static_cast<double>(pending)));
+}
+
+int main(int argc, char** argv) {
+    size_t pending = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 10000000;
+    mt19937_64 rng(281);
+
+    // placements advance slowly while filling so nothing comes due, then at a
+    // rate that keeps about `pending` transactions in the 3 day window
+    vector<Step> steps(2 * pending);
+    uint64_t placeDate = 80301000000ULL;
+    for (size_t i = 0; i < steps.size(); i++) {
+        if (i >= pending && rng() % pending < 6) placeDate += 1000000;
+        placeDate += rng() % 2;
+        steps[i] = {placeDate, placeDate + rng() % 3000001};
+    }
+
+    printf("%zu pending transactions\n", pending);
+    Result heap = run<HeapQueue>(steps, pending);
+    report("priority_queue", heap, pending);
+    Result calendar = run<CalendarQueue>(steps, pending);
+    report("CalendarQueue", calendar, pending);
+
+    if (heap.checksum != calendar.checksum) {
+        printf("execution order differs\n");
+        return 1;
+    }
+    printf("speedup %.2fx, same execution order\n",
+           (heap.fill + heap.steady + heap.drain) / (calendar.fill + calendar.steady + calendar.drain));
+    return 0;
+}
@@ -0,0 +1,159 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+// Load generator for bank --serve. Client 0 sends the operations of a
+// command file in order, every other client cycles through its queries (or
+// through balance commands if it has none), each keeping up to depth
+// commands in flight. A command's latency runs from the moment it was
+// written until the empty line that ends its reply has been read.
+//
+// usage: serve_load socket commands [clients, default 4] [depth, default 16] [seconds, default 5]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+struct Client
+{
+    int fd = -1;
+    const vector<string>* script = nullptr;
+    size_t next = 0; // next line of script to send
+    bool cycle = false; // start the script over when it runs out
+    string out; // written but not sent yet
+    deque<Clock::time_point> inFlight;
+    string in; // read but not a whole reply yet
+    bool lineStart = true; // the last byte read ended a line
+};
+
+int connectTo(const char* path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: serve_load socket commands [clients] [depth] [seconds]\n");
+        return 1;
+    }
+    size_t clientCount = (argc > 3) ? max<size_t>(strtoull(argv[3], nullptr, 10), 1) : 4;
+    size_t depth = (argc > 4) ? max<size_t>(strtoull(argv[4], nullptr, 10), 1) : 16;
+    double seconds = (argc > 5) ? atof(argv[5]) : 5;
+
+    vector<string> operations, queries, balances;
+    ifstream file(argv[2]);
+    string line;
+    bool inQueries = false;
+    while (getline(file, line))
+    {
+        if (line.empty() || line[0] == '#') continue;
+        if (line == "$$$") {
+            inQueries = true;
+        } else if (inQueries) {
+            queries.push_back(line);
+        } else {
+            operations.push_back(line);
+            if (line.compare(0, 8, "balance ") == 0) balances.push_back(line);
+        }
+    }
+    const vector<string>& reads = queries.empty() ? balances : queries;
+    if (operations.empty() || (clientCount > 1 && reads.empty())) {
+        fprintf(stderr, "%s has nothing to send\n", argv[2]);
+        return 1;
+    }
+
+    vector<Client> clients(clientCount);
+    for (size_t i = 0; i < clientCount; i++) {
+        clients[i].fd = connectTo(argv[1]);
+        if (clients[i].fd < 0) {
+            fprintf(stderr, "cannot connect to %s\n", argv[1]);
+            return 1;
+        }
+        clients[i].script = (i == 0) ? &operations : &reads;
+        clients[i].cycle = (i != 0);
+    }
+
+    vector<double> latencies; // microseconds
+    size_t operationReplies = 0, queryReplies = 0;
+    auto start = Clock::now();
+    auto deadline = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(seconds));
+    vector<pollfd> polls(clientCount);
+    char buffer[1 << 16];
+    while (true)
+    {
+        auto now = Clock::now();
+        bool sending = now < deadline;
+        bool busy = false;
+        for (size_t i = 0; i < clientCount; i++) {
+            Client& client = clients[i];
+            // top up the pipeline, the operations stop for good once they have all been sent
+            while (sending && client.inFlight.size() < depth && (client.cycle || client.next < client.script->size()))
+            {
+                if (client.next == client.script->size()) client.next = 0;
+                client.out += (*client.script)[client.next++];
+                client.out += '\n';
+                client.inFlight.push_back(now);
+            }
+            if (!client.out.empty()) {
+                ssize_t n = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+                if (n > 0) client.out.erase(0, static_cast<size_t>(n));
+            }
+            busy |= !client.inFlight.empty();
+            polls[i].fd = client.fd;
+            polls[i].events = static_cast<short>(POLLIN | (client.out.empty() ? 0 : POLLOUT));
+            polls[i].revents = 0;
+        }
+        if (!busy) break;
+        if (poll(polls.data(), polls.size(), 1000) <= 0) continue;
+
+        now = Clock::now();
+        for (size_t i = 0; i < clientCount; i++) {
+            Client& client = clients[i];
+            if ((polls[i].revents & (POLLERR | POLLHUP)) && !(polls[i].revents & POLLIN)) {
+                fprintf(stderr, "the server closed client %zu\n", i);
+                return 1;
+            }
+            if (!(polls[i].revents & POLLIN)) continue;
+            ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) continue;
+            // a reply ends at an empty line: a newline straight after another, or first thing
+            for (ssize_t b = 0; b < n; b++) {
+                if (buffer[b] == '\n' && client.lineStart && !client.inFlight.empty()) {
+                    latencies.push_back(chrono::duration<double, micro>(now - client.inFlight.front()).count());
+                    client.inFlight.pop_front();
+                    (i == 0 ? operationReplies : queryReplies)++;
+                }
+                client.lineStart = (buffer[b] == '\n');
+            }
+        }
+    }
+    double elapsed = chrono::duration<double>(Clock::now() - start).count();
+    for (Client& client : clients) close(client.fd);
+
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies.empty() ? 0.0 : latencies[min(latencies.size() - 1, static_cast<size_t>(p * static_cast<double>(latencies.size())))];
+    };
+    printf("%zu clients, depth %zu, %.2f s\n", clientCount, depth, elapsed);
+    printf("operations %zu, queries %zu, %.0f commands/s\n", operationReplies, queryReplies,
+           static_cast<double>(latencies.size()) / elapsed);
+    printf("latency p50 %.1f us, p99 %.1f us, max %.1f us\n", percentile(0.5), percentile(0.99), latencies.empty() ? 0.0 : latencies.back());
+    return 0;
+}
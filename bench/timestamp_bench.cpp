@@ -0,0 +1,203 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+// Times the timestamp codec against the code it replaced: twelve scalar
+// multiply-adds per parse, and a division and a remainder per field when
+// taking an interval apart. The old parse checked nothing, so the parser is
+// also timed against scalar code that makes the same checks it does.
+//
+// Before timing, the parser is checked against the old arithmetic on random
+// timestamps and against every single byte corruption of a valid one, and
+// splitTimeStamp() against the divisions on every six digit half and on
+// values of 10^12 and more.
+//
+// usage: bench_timestamp [timestamp count, default 10000000] [rounds, default 10]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../timestamp.h"
+
+using namespace std;
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+uint64_t oldConvert(string_view timestamp) {
+    uint64_t ans = 0;
+    ans += (timestamp[0] - '0') * 100000000000ULL;
+    ans += (timestamp[1] - '0') * 10000000000ULL;
+    ans += (timestamp[3] - '0') * 1000000000ULL;
+    ans += (timestamp[4] - '0') * 100000000ULL;
+    ans += (timestamp[6] - '0') * 10000000ULL;
+    ans += (timestamp[7] - '0') * 1000000ULL;
+    ans += (timestamp[9] - '0') * 100000ULL;
+    ans += (timestamp[10] - '0') * 10000ULL;
+    ans += (timestamp[12] - '0') * 1000ULL;
+    ans += (timestamp[13] - '0') * 100ULL;
+    ans += (timestamp[15] - '0') * 10ULL;
+    ans += (timestamp[16] - '0') * 1ULL;
+    return ans;
+}
+
+// the scalar code with the checks parseTimeStamp() makes, a colon or a digit per byte
+bool checkedConvert(string_view timestamp, uint64_t& value) {
+    if (timestamp.size() != 17) return false;
+    uint64_t ans = 0;
+    for (size_t i = 0; i < 17; i++) {
+        char byte = timestamp[i];
+        if (i % 3 == 2) {
+            if (byte != ':') return false;
+        } else {
+            if (byte < '0' || byte > '9') return false;
+            ans = ans * 10 + static_cast<uint64_t>(byte - '0');
+        }
+    }
+    value = ans;
+    return true;
+}
+
+void oldSplit(uint64_t value, uint32_t* fields) {
+    static constexpr uint64_t UNIT[] = {10000000000ULL, 100000000ULL, 1000000ULL, 10000ULL, 100ULL, 1ULL};
+    for (size_t i = 0; i < 6; i++) {
+        fields[i] = static_cast<uint32_t>(value / UNIT[i]);
+        value %= UNIT[i];
+    }
+}
+
+string format(uint64_t value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%02u:%02u:%02u:%02u:%02u:%02u", unsigned(value / 10000000000ULL % 100), unsigned(value / 100000000 % 100),
+             unsigned(value / 1000000 % 100), unsigned(value / 10000 % 100), unsigned(value / 100 % 100), unsigned(value % 100));
+    return text;
+}
+
+bool checkParser(mt19937_64& rng) {
+    for (int i = 0; i < 1000000; i++) {
+        uint64_t value = rng() % 1000000000000ULL;
+        string text = format(value);
+        uint64_t parsed;
+        if (!parseTimeStamp(text, parsed) || parsed != value || parsed != oldConvert(text)) {
+            printf("parse mismatch on %s\n", text.c_str());
+            return false;
+        }
+    }
+    const string valid = "99:12:31:23:59:58";
+    for (size_t pos = 0; pos < valid.size(); pos++) {
+        for (int byte = 0; byte < 256; byte++) {
+            string text = valid;
+            text[pos] = static_cast<char>(byte);
+            bool colon = (pos % 3 == 2);
+            bool expected = colon ? (byte == ':') : (byte >= '0' && byte <= '9');
+            uint64_t parsed;
+            if (parseTimeStamp(text, parsed) != expected) {
+                printf("byte %d at %zu %s\n", byte, pos, expected ? "rejected" : "accepted");
+                return false;
+            }
+        }
+    }
+    uint64_t parsed;
+    if (parseTimeStamp("99:12:31:23:59:5", parsed) || parseTimeStamp("99:12:31:23:59:588", parsed)) {
+        printf("wrong length accepted\n");
+        return false;
+    }
+    return true;
+}
+
+bool checkSplit(mt19937_64& rng) {
+    uint32_t fields[6], expected[6];
+    for (uint64_t half = 0; half < 1000000; half++) {
+        // both six digit halves exhaustively, and values of 10^12 and more, as a wrapped interval is
+        const uint64_t values[] = {half, half * 1000000 + 999999 - half, rng(), UINT64_MAX - half, 1000000000000ULL + half};
+        for (uint64_t value : values) {
+            splitTimeStamp(value, fields);
+            oldSplit(value, expected);
+            for (size_t i = 0; i < 6; i++) {
+                if (fields[i] != expected[i]) {
+                    printf("split mismatch on %llu\n", static_cast<unsigned long long>(value));
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t count = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 10000000;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 10;
+    mt19937_64 rng(281);
+    if (!checkParser(rng) || !checkSplit(rng)) return 1;
+
+    // the timestamps back to back as in a command file, parsed through views
+    string text;
+    vector<string_view> views(count);
+    vector<uint64_t> intervals(count);
+    text.reserve(count * 18);
+    for (size_t i = 0; i < count; i++) {
+        text += format(rng() % 1000000000000ULL);
+        text += '\n';
+        intervals[i] = rng() % 1000000000000ULL;
+    }
+    for (size_t i = 0; i < count; i++) views[i] = string_view(text).substr(i * 18, 17);
+
+    vector<uint64_t> oldValues(count), checkedValues(count), newValues(count), batchValues(count);
+    double oldTime = 1e300, checkedTime = 1e300, newTime = 1e300, batchTime = 1e300, oldSplitTime = 1e300, newSplitTime = 1e300;
+    uint64_t oldSum = 0, newSum = 0;
+    bool ok = true;
+    for (int round = 0; round < rounds; round++) {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++) oldValues[i] = oldConvert(views[i]);
+        oldTime = min(oldTime, secondsSince(start));
+
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++) ok &= checkedConvert(views[i], checkedValues[i]);
+        checkedTime = min(checkedTime, secondsSince(start));
+
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++) ok &= parseTimeStamp(views[i], newValues[i]);
+        newTime = min(newTime, secondsSince(start));
+
+        start = chrono::steady_clock::now();
+        ok &= parseTimeStamps(views.data(), count, batchValues.data());
+        batchTime = min(batchTime, secondsSince(start));
+
+        uint32_t fields[6];
+        start = chrono::steady_clock::now();
+        oldSum = 0;
+        for (size_t i = 0; i < count; i++) {
+            oldSplit(intervals[i], fields);
+            oldSum += fields[0] + fields[1] + fields[2] + fields[3] + fields[4] + fields[5];
+        }
+        oldSplitTime = min(oldSplitTime, secondsSince(start));
+
+        start = chrono::steady_clock::now();
+        newSum = 0;
+        for (size_t i = 0; i < count; i++) {
+            splitTimeStamp(intervals[i], fields);
+            newSum += fields[0] + fields[1] + fields[2] + fields[3] + fields[4] + fields[5];
+        }
+        newSplitTime = min(newSplitTime, secondsSince(start));
+    }
+
+    auto row = [count](const char* name, double seconds) {
+        printf("%-20s %8.3f ms  %6.2f ns/timestamp\n", name, seconds * 1e3, seconds * 1e9 / static_cast<double>(count));
+    };
+    printf("%zu timestamps, best of %d rounds\n", count, rounds);
+    row("scalar parse", oldTime);
+    row("checked scalar", checkedTime);
+    row("parseTimeStamp", newTime);
+    row("parseTimeStamps", batchTime);
+    row("divide and modulo", oldSplitTime);
+    row("splitTimeStamp", newSplitTime);
+    if (!ok || oldValues != checkedValues || oldValues != newValues || oldValues != batchValues || oldSum != newSum) {
+        printf("results differ\n");
+        return 1;
+    }
+    printf("parse speedup %.2fx (batch %.2fx) over unchecked scalar, %.2fx (batch %.2fx) over checked scalar,\n"
+           "split speedup %.2fx, identical results\n",
+           oldTime / newTime, oldTime / batchTime, checkedTime / newTime, checkedTime / batchTime, oldSplitTime / newSplitTime);
+    return 0;
+}
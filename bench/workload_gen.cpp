@@ -0,0 +1,249 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+// Writes a synthetic registration file and command stream for bank.
+//
+// The operations follow the spec: placement timestamps never decrease and
+// logins, logouts and balance checks mostly refer to sessions that exist,
+// so most places go through to the scheduler. A chosen fraction of commands
+// is made to fail one of the checks instead (unknown account, wrong PIN or
+// IP, self transfer, execution date too far out). The queries after $$$
+// cover the time range the operations used. With --burst the places come in
+// bursts that share one execution date, so the first place of the next
+// burst executes a whole burst in one drain.
+//
+// The output only depends on the options: the random numbers come from a
+// fixed splitmix64 sequence, not from the standard library distributions.
+//
+// usage: workload_gen [options] <output prefix>
+//   writes <prefix>-reg.txt and <prefix>-commands.txt
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct Options {
+    uint64_t users = 10000;
+    uint64_t commands = 100000;
+    uint64_t queries = 1000;
+    double placeRate = 0.6; // of the operations
+    double churn = 0.25;    // login and out, the rest are balance checks
+    double invalid = 0.05;  // commands made to fail a check
+    double mix[4] = {1, 1, 1, 1}; // weights of l, r, h, s
+    uint64_t burst = 0;     // places per burst, 0: none
+    uint64_t seed = 1;
+};
+
+class Random {
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // in [0, n)
+    uint64_t below(uint64_t n) { return next() % n; }
+    double unit() { return static_cast<double>(next() >> 11) / 9007199254740992.0; }
+    bool chance(double p) { return unit() < p; }
+
+private:
+    uint64_t state;
+};
+
+struct Account {
+    string pin;
+    vector<uint32_t> ips; // open sessions
+};
+
+string timestamp(uint64_t value) {
+    char digits[13];
+    snprintf(digits, sizeof(digits), "%012llu", static_cast<unsigned long long>(value % 1000000000000ULL));
+    string ans;
+    for (int i = 0; i < 12; i += 2) {
+        if (i != 0) ans += ':';
+        ans.append(digits + i, 2);
+    }
+    return ans;
+}
+
+string address(uint32_t ip) {
+    return to_string(ip >> 24) + '.' + to_string((ip >> 16) & 0xFF) + '.' + to_string((ip >> 8) & 0xFF) + '.' + to_string(ip & 0xFF);
+}
+
+string userName(uint64_t id) {
+    return "user" + to_string(id);
+}
+
+void parseMix(const char* text, double mix[4]) {
+    if (sscanf(text, "%lf,%lf,%lf,%lf", &mix[0], &mix[1], &mix[2], &mix[3]) != 4) {
+        fprintf(stderr, "--mix takes four comma separated weights for l,r,h,s\n");
+        exit(1);
+    }
+}
+
+void usage() {
+    fprintf(stderr,
+            "usage: workload_gen [options] <output prefix>\n"
+            "  --users N        registered accounts (10000)\n"
+            "  --commands N     operations before $$$ (100000)\n"
+            "  --queries N      queries after $$$ (1000)\n"
+            "  --place-rate F   fraction of operations that are place (0.6)\n"
+            "  --churn F        fraction of operations that are login/out (0.25)\n"
+            "  --invalid F      fraction of commands that fail a check (0.05)\n"
+            "  --mix L,R,H,S    query weights (1,1,1,1)\n"
+            "  --burst N        places per burst that execute together (0: no bursts)\n"
+            "  --seed N         random seed (1)\n");
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    static option long_options[] = {
+        {"users",      required_argument, nullptr, 'u'},
+        {"commands",   required_argument, nullptr, 'c'},
+        {"queries",    required_argument, nullptr, 'q'},
+        {"place-rate", required_argument, nullptr, 'p'},
+        {"churn",      required_argument, nullptr, 'l'},
+        {"invalid",    required_argument, nullptr, 'i'},
+        {"mix",        required_argument, nullptr, 'm'},
+        {"burst",      required_argument, nullptr, 'b'},
+        {"seed",       required_argument, nullptr, 's'},
+        {"help",       no_argument,       nullptr, 'h'},
+        {nullptr,      0,                 nullptr,  0}
+    };
+    int choice;
+    while ((choice = getopt_long(argc, argv, "h", long_options, nullptr)) != -1) {
+        switch (choice) {
+        case 'u': options.users = strtoull(optarg, nullptr, 10); break;
+        case 'c': options.commands = strtoull(optarg, nullptr, 10); break;
+        case 'q': options.queries = strtoull(optarg, nullptr, 10); break;
+        case 'p': options.placeRate = atof(optarg); break;
+        case 'l': options.churn = atof(optarg); break;
+        case 'i': options.invalid = atof(optarg); break;
+        case 'm': parseMix(optarg, options.mix); break;
+        case 'b': options.burst = strtoull(optarg, nullptr, 10); break;
+        case 's': options.seed = strtoull(optarg, nullptr, 10); break;
+        case 'h': usage(); return 0;
+        default: usage(); return 1;
+        }
+    }
+    if (optind + 1 != argc || options.users < 2) {
+        usage();
+        return 1;
+    }
+    string prefix = argv[optind];
+    Random random(options.seed);
+
+    // everyone registers at the start, a few a little later
+    vector<Account> accounts(options.users);
+    {
+        ofstream reg(prefix + "-reg.txt");
+        for (uint64_t id = 0; id < options.users; id++)
+        {
+            accounts[id].pin = to_string(100000 + random.below(900000));
+            uint64_t registered = random.chance(0.02) ? 1000000 + random.below(1000000) : 0;
+            reg << timestamp(registered) << '|' << userName(id) << '|' << accounts[id].pin << '|' << random.below(1000000) << '\n';
+        }
+    }
+
+    ofstream commands(prefix + "-commands.txt");
+    commands << "# generated by workload_gen, seed " << options.seed << '\n';
+    vector<uint32_t> loggedIn; // accounts with at least one session, may hold stale entries
+    uint64_t now = 2000000;
+    uint64_t burstPlaced = 0, burstExecute = 0;
+    for (uint64_t i = 0; i < options.commands; i++)
+    {
+        bool invalid = random.chance(options.invalid);
+        double kind = random.unit();
+        uint32_t id = static_cast<uint32_t>(random.below(options.users));
+        Account* account = &accounts[id];
+
+        if (kind < options.placeRate && !loggedIn.empty()) {
+            // a sender that is logged in, usually
+            size_t pick = random.below(loggedIn.size());
+            id = loggedIn[pick];
+            account = &accounts[id];
+            if (account->ips.empty()) {
+                loggedIn[pick] = loggedIn.back();
+                loggedIn.pop_back();
+                i--;
+                continue;
+            }
+            uint64_t execute;
+            if (options.burst == 0) {
+                now += random.below(4) == 0 ? random.below(100000) : random.below(100);
+                execute = now + random.below(3000001);
+            } else {
+                // a new burst starts after the previous one's execution date
+                if (burstPlaced++ % options.burst == 0) {
+                    now += 3000001;
+                    burstExecute = now + random.below(3000001);
+                }
+                execute = burstExecute;
+            }
+            uint32_t recipient = static_cast<uint32_t>(random.below(options.users));
+            if (recipient == id) recipient = static_cast<uint32_t>((id + 1) % options.users);
+            string sender = userName(id);
+            string ip = address(account->ips[random.below(account->ips.size())]);
+            if (invalid) {
+                switch (random.below(4)) {
+                case 0: sender = "nobody" + to_string(i); break;
+                case 1: ip = "0.0.0.1"; break;
+                case 2: recipient = id; break;
+                default: execute = now + 3000001 + random.below(1000000); break;
+                }
+            }
+            uint64_t amount = random.chance(0.9) ? 1 + random.below(5000) : 1 + random.below(500000);
+            commands << "place " << timestamp(now) << ' ' << ip << ' ' << sender << ' ' << userName(recipient) << ' '
+                     << amount << ' ' << timestamp(execute) << ' ' << (random.chance(0.5) ? 'o' : 's') << '\n';
+        } else if (kind < options.placeRate + options.churn) {
+            if (!account->ips.empty() && random.chance(0.5)) {
+                size_t pick = random.below(account->ips.size());
+                uint32_t ip = invalid ? 0x7F000001 : account->ips[pick];
+                commands << "out " << userName(id) << ' ' << address(ip) << '\n';
+                if (!invalid) {
+                    account->ips[pick] = account->ips.back();
+                    account->ips.pop_back();
+                }
+            } else {
+                uint32_t ip = 0x0A000000 | static_cast<uint32_t>(random.below(1 << 24));
+                commands << "login " << userName(id) << ' ' << (invalid ? "000000" : account->pin) << ' ' << address(ip) << '\n';
+                if (!invalid) {
+                    if (account->ips.empty()) loggedIn.push_back(id);
+                    account->ips.push_back(ip);
+                }
+            }
+        } else {
+            string name = invalid ? "nobody" + to_string(i) : userName(id);
+            uint32_t ip = account->ips.empty() ? 0x7F000001 : account->ips[random.below(account->ips.size())];
+            commands << "balance " << name << ' ' << address(ip) << '\n';
+        }
+    }
+    commands << "$$$\n";
+
+    double total = options.mix[0] + options.mix[1] + options.mix[2] + options.mix[3];
+    for (uint64_t i = 0; i < options.queries; i++)
+    {
+        double kind = random.unit() * total;
+        uint64_t start = random.below(now + 3000000);
+        // mostly short ranges, l alone can otherwise print every transaction for each query
+        uint64_t length = random.chance(0.9) ? random.below(100000) : random.below(10000000);
+        if (kind < options.mix[0]) {
+            commands << "l " << timestamp(start) << ' ' << timestamp(start + length) << '\n';
+        } else if (kind < options.mix[0] + options.mix[1]) {
+            commands << "r " << timestamp(start) << ' ' << timestamp(start + length) << '\n';
+        } else if (kind < options.mix[0] + options.mix[1] + options.mix[2]) {
+            commands << "h " << userName(random.below(options.users)) << '\n';
+        } else {
+            commands << "s " << timestamp(start) << '\n';
+        }
+    }
+    return 0;
+}
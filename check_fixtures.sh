@@ -0,0 +1,172 @@
+#!/bin/sh
+# Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+# Runs spec-commands.txt and every test-N-commands.txt that has an
+# expected test-N-output.txt and compares what bank prints, in each of the
+# modes that must not change the output:
+#
+#   plain          -f test-N-reg.txt < test-N-commands.txt
+#   --pipeline     the same on three threads
+#   --archive      with the executed transactions moved into segment files
+#   snapshot       the operations with --snapshot-out, then $$$ and the
+#                  queries from --snapshot-in
+#   journal        the operations with --journal, then $$$ and the queries
+#                  from --recover
+#
+# and, where the expected files exist, -v against test-N-output-verbose.txt
+# and --events against test-N-events.bin. A "# options: ..." line in the
+# command file adds those options to every run, e.g. --online.
+#
+# The fixtures without options then run once more as the jobs of one --batch
+# manifest, on one thread, so each job reuses the bank the one before it
+# cleared, and on three, and with -v; each job has to print what its plain
+# run does.
+#
+# Given a stats build too, it answers the queries of each fixture 200 times
+# on four threads and checks that --stats-json counts every one of them.
+#
+# Given workload_gen too, it generates workloads too large to keep in the
+# tree, each big enough to reach code the fixtures above never do, and
+# compares every mode against the plain run on one thread:
+#
+#   large          over two SEGMENT_SIZE runs of executed transactions, so
+#                  --archive seals segments and looks dates up in them, also
+#                  when it restores a snapshot taken without --archive
+#   bursts         places in bursts of 10000 that execute in one drain, so
+#                  -v --jobs 4 settles them by conflict levels on the pool
+#                  and has to print what -v --jobs 1 does one by one
+#
+# usage: check_fixtures.sh <bank> [<bank_stats> [<workload_gen>]]
+BANK=$1
+STATS_BANK=$2
+WORKLOAD_GEN=$3
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+failed=0
+
+# compare <what> <expected> <actual>
+compare() {
+    if ! cmp -s "$2" "$3"; then
+        echo "FAIL $fixture: $1"
+        failed=1
+    fi
+}
+
+for commands in spec-commands.txt test-*-commands.txt; do
+    fixture=${commands%-commands.txt}
+    expected=$fixture-output.txt
+    [ -f "$expected" ] || continue
+    reg=$fixture-reg.txt
+    options=$(sed -n 's/^# options: //p' "$commands")
+    sed '/^\$\$\$/,$d' "$commands" > "$WORK/operations.txt"
+    { echo '$$$'; sed '1,/^\$\$\$/d' "$commands"; } > "$WORK/queries.txt"
+
+    # shellcheck disable=SC2086
+    {
+        "$BANK" -f "$reg" $options < "$commands" > "$WORK/out.txt" 2>&1
+        compare plain "$expected" "$WORK/out.txt"
+
+        "$BANK" -f "$reg" $options --pipeline < "$commands" > "$WORK/out.txt" 2>&1
+        compare --pipeline "$expected" "$WORK/out.txt"
+
+        rm -rf "$WORK/archive"
+        mkdir "$WORK/archive"
+        "$BANK" -f "$reg" $options --archive "$WORK/archive" < "$commands" > "$WORK/out.txt" 2>&1
+        compare --archive "$expected" "$WORK/out.txt"
+
+        "$BANK" -f "$reg" $options --snapshot-out "$WORK/state.snap" < "$WORK/operations.txt" > "$WORK/out.txt" 2>&1
+        "$BANK" --snapshot-in "$WORK/state.snap" $options < "$WORK/queries.txt" >> "$WORK/out.txt" 2>&1
+        compare snapshot "$expected" "$WORK/out.txt"
+
+        rm -f "$WORK/bank.wal"
+        "$BANK" -f "$reg" $options --journal "$WORK/bank.wal" < "$WORK/operations.txt" > "$WORK/out.txt" 2>&1
+        "$BANK" -f "$reg" $options --recover "$WORK/bank.wal" < "$WORK/queries.txt" >> "$WORK/out.txt" 2>&1
+        compare journal "$expected" "$WORK/out.txt"
+
+        if [ -f "$fixture-output-verbose.txt" ]; then
+            "$BANK" -f "$reg" $options -v < "$commands" > "$WORK/out.txt" 2>&1
+            compare -v "$fixture-output-verbose.txt" "$WORK/out.txt"
+        fi
+
+        if [ -f "$fixture-events.bin" ]; then
+            "$BANK" -f "$reg" $options --events "$WORK/events.bin" < "$commands" > /dev/null 2>&1
+            compare --events "$fixture-events.bin" "$WORK/events.bin"
+        fi
+
+        if [ -n "$STATS_BANK" ]; then
+            cp "$WORK/operations.txt" "$WORK/many.txt"
+            echo '$$$' >> "$WORK/many.txt"
+            for i in $(seq 200); do sed 1d "$WORK/queries.txt" >> "$WORK/many.txt"; done
+            "$STATS_BANK" -f "$reg" $options --jobs 4 --stats-json "$WORK/stats.json" < "$WORK/many.txt" > /dev/null 2>&1
+            for kind in l r h s b p t; do
+                asked=$(grep -c "^$kind " "$WORK/many.txt")
+                counted=$(sed -n "s/^ *\"$kind\": {\"count\": \([0-9]*\).*/\1/p" "$WORK/stats.json")
+                if [ "$asked" != "$counted" ]; then
+                    echo "FAIL $fixture: --stats counted $counted of $asked '$kind' queries"
+                    failed=1
+                fi
+            done
+        fi
+    }
+    [ $failed -ne 0 ] || echo "ok   $fixture"
+done
+
+fixture=batch
+rm -f "$WORK/manifest.txt"
+for commands in spec-commands.txt test-*-commands.txt; do
+    job=${commands%-commands.txt}
+    [ -f "$job-output.txt" ] && ! grep -q '^# options: ' "$commands" || continue
+    echo "$job-reg.txt $commands $WORK/batch-$job.txt" >> "$WORK/manifest.txt"
+done
+for options in "--jobs 1" "--jobs 3" "--jobs 3 -v"; do
+    # shellcheck disable=SC2086
+    if ! "$BANK" --batch "$WORK/manifest.txt" $options > /dev/null 2>&1; then
+        echo "FAIL $fixture: $options failed"
+        failed=1
+    fi
+    while read -r reg commands output; do
+        job=${commands%-commands.txt}
+        case $options in
+            *-v) [ ! -f "$job-output-verbose.txt" ] || compare "$options $job" "$job-output-verbose.txt" "$output" ;;
+            *) compare "$options $job" "$job-output.txt" "$output" ;;
+        esac
+    done < "$WORK/manifest.txt"
+done
+[ $failed -ne 0 ] || echo "ok   $fixture"
+
+if [ -n "$WORKLOAD_GEN" ]; then
+    fixture=large
+    "$WORKLOAD_GEN" --users 2000 --commands 300000 --queries 300 --invalid 0.02 "$WORK/large" > /dev/null
+    reg=$WORK/large-reg.txt
+    commands=$WORK/large-commands.txt
+    "$BANK" -f "$reg" --jobs 1 < "$commands" > "$WORK/expected.txt" 2>&1
+
+    rm -rf "$WORK/archive"
+    mkdir "$WORK/archive"
+    "$BANK" -f "$reg" --jobs 1 --archive "$WORK/archive" < "$commands" > "$WORK/out.txt" 2>&1
+    compare --archive "$WORK/expected.txt" "$WORK/out.txt"
+    if [ ! -f "$WORK/archive/segment-000001.bin" ]; then
+        echo "FAIL $fixture: --archive sealed fewer than two segments"
+        failed=1
+    fi
+
+    sed '/^\$\$\$/,$d' "$commands" > "$WORK/operations.txt"
+    { echo '$$$'; sed '1,/^\$\$\$/d' "$commands"; } > "$WORK/queries.txt"
+    rm -rf "$WORK/archive"
+    mkdir "$WORK/archive"
+    "$BANK" -f "$reg" --jobs 1 --snapshot-out "$WORK/state.snap" < "$WORK/operations.txt" > "$WORK/out.txt" 2>&1
+    "$BANK" --snapshot-in "$WORK/state.snap" --jobs 1 --archive "$WORK/archive" < "$WORK/queries.txt" >> "$WORK/out.txt" 2>&1
+    compare "snapshot into --archive" "$WORK/expected.txt" "$WORK/out.txt"
+
+    [ $failed -ne 0 ] || echo "ok   $fixture"
+
+    fixture=bursts
+    "$WORKLOAD_GEN" --users 100000 --commands 200000 --queries 300 --burst 10000 --churn 0.5 --place-rate 0.45 "$WORK/bursts" > /dev/null
+    reg=$WORK/bursts-reg.txt
+    commands=$WORK/bursts-commands.txt
+    "$BANK" -f "$reg" -v --jobs 1 < "$commands" > "$WORK/expected.txt" 2>&1
+    "$BANK" -f "$reg" -v --jobs 4 < "$commands" > "$WORK/out.txt" 2>&1
+    compare "-v --jobs 4" "$WORK/expected.txt" "$WORK/out.txt"
+
+    [ $failed -ne 0 ] || echo "ok   $fixture"
+fi
+exit $failed
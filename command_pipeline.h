@@ -0,0 +1,199 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef COMMAND_PIPELINE_H
+#define COMMAND_PIPELINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include "command_reader.h"
+#include "output_writer.h"
+#include "spsc_ring.h"
+
+// A run of command lines on its way through the pipeline, together with the
+// output that executing them produced.
+struct CommandBatch
+{
+    static constexpr size_t MAX_LINES = 4096;
+    static constexpr size_t MAX_TEXT = 1 << 18;
+
+    std::vector<char> text; // copies of the lines, when the reader's do not stay valid
+    std::vector<size_t> ends; // end of every copied line in text
+    std::vector<std::string_view> lines;
+    std::vector<CommandFields> fields; // tokenized lines
+    OutputWriter output{-1, 1 << 16};
+};
+
+// Runs the operations phase as three stages on three threads: a reader that
+// reads and tokenizes command lines, the caller, which executes them one by
+// one exactly as before, and a writer that writes their output. Batches go
+// round through single producer single consumer rings, reader to caller to
+// writer and back to the reader, so every stage works on its own batch.
+//
+// The reader hands a batch over as soon as the next line would have to wait
+// for input, so interactive use still gets a reply per command, and stops
+// right after the $$$ line, leaving the queries to the caller's reader.
+class CommandPipeline {
+public:
+    static constexpr size_t BATCHES = 8;
+
+    CommandPipeline(CommandReader& reader_in, int fd_in, OutputWriter& output_in)
+        : reader(reader_in), fd(fd_in), output(output_in) {
+        for (CommandBatch& batch : batches) emptyBatches.tryPush(&batch);
+        readerThread = std::thread([this] { readLoop(); });
+        writerThread = std::thread([this] { writeLoop(); });
+    }
+
+    ~CommandPipeline() {
+        if (writerThread.joinable()) {
+            try
+            {
+                finish();
+            }
+            catch (const char*)
+            {
+                // already unwinding from an error of the caller's
+            }
+        }
+    }
+
+    CommandPipeline(const CommandPipeline&) = delete;
+    CommandPipeline& operator=(const CommandPipeline&) = delete;
+
+    // the next batch to execute, nullptr once the input is used up
+    CommandBatch* next() {
+        CommandBatch* batch;
+        unsigned spins = 0;
+        while (!parsedBatches.tryPop(batch)) ringBackoff(spins);
+        return batch;
+    }
+
+    // hands an executed batch on to the writer
+    void done(CommandBatch* batch) {
+        unsigned spins = 0;
+        while (!executedBatches.tryPush(batch)) ringBackoff(spins);
+    }
+
+    // writes out every batch handed over and stops both threads; the reader
+    // and the output belong to the caller again afterwards
+    void finish() {
+        stopping.store(true, std::memory_order_relaxed);
+        done(nullptr);
+        writerThread.join();
+        readerThread.join();
+        if (readError != nullptr) throw readError;
+    }
+
+private:
+    CommandReader& reader;
+    int fd;
+    OutputWriter& output;
+    CommandBatch batches[BATCHES];
+    // more slots than batches, so the end markers always fit
+    SpscRing<CommandBatch*, 2 * BATCHES> emptyBatches; // writer to reader
+    SpscRing<CommandBatch*, 2 * BATCHES> parsedBatches; // reader to caller
+    SpscRing<CommandBatch*, 2 * BATCHES> executedBatches; // caller to writer
+    std::thread readerThread;
+    std::thread writerThread;
+    std::atomic<bool> stopping{false};
+    const char* readError = nullptr; // read by the caller after the join
+
+    void readLoop() {
+        try
+        {
+            bool more = true;
+            while (more)
+            {
+                CommandBatch* batch;
+                unsigned spins = 0;
+                while (!emptyBatches.tryPop(batch)) {
+                    if (stopping.load(std::memory_order_relaxed)) return;
+                    ringBackoff(spins);
+                }
+                more = fill(*batch);
+                if (stopping.load(std::memory_order_relaxed)) return;
+                parsedBatches.tryPush(batch);
+            }
+        }
+        catch (const char* err)
+        {
+            readError = err;
+        }
+        parsedBatches.tryPush(nullptr);
+    }
+
+    // reads lines into batch until it is full, the input would block or the
+    // commands end; returns whether more may follow
+    bool fill(CommandBatch& batch) {
+        batch.text.clear();
+        batch.ends.clear();
+        batch.lines.clear();
+        bool more = true;
+        while (batch.lines.size() + batch.ends.size() < CommandBatch::MAX_LINES && batch.text.size() < CommandBatch::MAX_TEXT)
+        {
+            if (!reader.lineReady()) {
+                if (!batch.lines.empty() || !batch.ends.empty()) break;
+                if (!waitForLine()) break;
+            }
+            std::string_view line;
+            if (!reader.nextLine(line)) {
+                more = false;
+                break;
+            }
+            if (reader.stable()) {
+                batch.lines.push_back(line);
+            } else {
+                batch.text.insert(batch.text.end(), line.begin(), line.end());
+                batch.ends.push_back(batch.text.size());
+            }
+            if (line == "$$$") {
+                more = false;
+                break;
+            }
+        }
+
+        // the copies stopped moving, point the lines at them and tokenize
+        size_t start = 0;
+        for (size_t end : batch.ends) {
+            batch.lines.emplace_back(batch.text.data() + start, end - start);
+            start = end;
+        }
+        batch.fields.resize(batch.lines.size());
+        for (size_t i = 0; i < batch.lines.size(); i++) tokenize(batch.lines[i], batch.fields[i]);
+        return more;
+    }
+
+    // blocks until a whole line or the end of the input is there, false if
+    // the pipeline is stopping first. Each read waits for poll, so a stop
+    // is noticed even while the input holds half a line and stays open.
+    bool waitForLine() {
+        pollfd request = {fd, POLLIN, 0};
+        while (!reader.lineReady())
+        {
+            while (poll(&request, 1, 100) == 0) {
+                if (stopping.load(std::memory_order_relaxed)) return false;
+            }
+            reader.readAvailable(); // readable, closed, or an error read() reports
+        }
+        return true;
+    }
+
+    void writeLoop() {
+        while (true)
+        {
+            CommandBatch* batch;
+            unsigned spins = 0;
+            while (!executedBatches.tryPop(batch)) ringBackoff(spins);
+            if (batch == nullptr) return;
+            output << batch->output.view();
+            batch->output.clear();
+            emptyBatches.tryPush(batch);
+            // nothing else to write for now, let the output out rather than hold it back
+            if (executedBatches.empty()) output.flush();
+        }
+    }
+};
+
+#endif
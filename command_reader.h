@@ -0,0 +1,154 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef COMMAND_READER_H
+#define COMMAND_READER_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Whitespace separated fields of one command line. Every field is a view into
+// the CommandReader buffer, so it is only valid until the next nextLine() call.
+struct CommandFields
+{
+    static constexpr size_t MAX_FIELDS = 8; // place has the most fields
+    std::string_view field[MAX_FIELDS];
+    size_t count = 0;
+
+    // missing fields read as empty, the same as extracting past the end of a stringstream
+    std::string_view operator[](size_t i) const {
+        return (i < count) ? field[i] : std::string_view();
+    }
+};
+
+inline bool isFieldSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+inline void tokenize(std::string_view line, CommandFields& fields) {
+    fields.count = 0;
+    size_t i = 0;
+    while (fields.count < CommandFields::MAX_FIELDS)
+    {
+        while (i < line.size() && isFieldSpace(line[i])) i++;
+        if (i == line.size()) break;
+        size_t start = i;
+        while (i < line.size() && !isFieldSpace(line[i])) i++;
+        fields.field[fields.count++] = line.substr(start, i - start);
+    }
+}
+
+// Reads command lines from a file descriptor without copying them out.
+// A regular file is mmapped as a whole, anything else (pipe, terminal) is
+// read in large blocks; a line that crosses a block boundary is moved to the
+// front of the buffer before the next read.
+class CommandReader {
+public:
+    explicit CommandReader(int fd_in) : fd(fd_in) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                data = static_cast<const char*>(addr);
+                size = static_cast<size_t>(st.st_size);
+                mapped = true;
+                eof = true;
+                return;
+            }
+        }
+        buffer.resize(BLOCK_SIZE);
+        data = buffer.data();
+    }
+
+    ~CommandReader() {
+        if (mapped) munmap(const_cast<char*>(data), size);
+    }
+
+    CommandReader(const CommandReader&) = delete;
+    CommandReader& operator=(const CommandReader&) = delete;
+
+    // same contract as getline: the trailing '\n' is dropped and a last line
+    // without one is still returned
+    bool nextLine(std::string_view& line) {
+        while (true)
+        {
+            const void* nl = memchr(data + pos, '\n', size - pos);
+            if (nl != nullptr) {
+                size_t end = static_cast<size_t>(static_cast<const char*>(nl) - data);
+                line = std::string_view(data + pos, end - pos);
+                pos = end + 1;
+                return true;
+            }
+            if (!eof) {
+                refill();
+                continue;
+            }
+            if (pos < size) {
+                line = std::string_view(data + pos, size - pos);
+                pos = size;
+                return true;
+            }
+            return false;
+        }
+    }
+
+    // reads everything up to the end of the input now, so the lines returned
+    // from here on all stay valid for the lifetime of the reader
+    void loadRemaining() {
+        while (!eof) refill();
+    }
+
+    // one read of whatever input there is, for a caller that polled the fd first
+    void readAvailable() {
+        if (!eof) refill();
+    }
+
+    // whether nextLine() can answer without waiting for more input
+    bool lineReady() const {
+        return eof || memchr(data + pos, '\n', size - pos) != nullptr;
+    }
+
+    // whether the lines stay valid for the lifetime of the reader, i.e. the input is mapped
+    bool stable() const { return mapped; }
+
+    // everything not handed out by nextLine() yet, call loadRemaining() first
+    std::string_view remaining() const { return std::string_view(data + pos, size - pos); }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+    int fd;
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+    bool mapped = false;
+    bool eof = false;
+    std::vector<char> buffer;
+
+    void refill() {
+        // keep the unfinished line, grow only when a single line fills the buffer
+        if (pos != 0) {
+            size -= pos;
+            memmove(buffer.data(), buffer.data() + pos, size);
+            pos = 0;
+        }
+        if (size == buffer.size()) buffer.resize(buffer.size() * 2);
+        data = buffer.data();
+
+        ssize_t n;
+        do {
+            n = read(fd, buffer.data() + size, buffer.size() - size);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0) throw "Error: Reading from cin has failed\n";
+        if (n == 0) eof = true;
+        size += static_cast<size_t>(n);
+    }
+};
+
+#endif
@@ -0,0 +1,84 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef DAILY_TOTALS_H
+#define DAILY_TOTALS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "fee.h"
+#include "transaction.h"
+
+// What one account sent, received and paid in fees over one day.
+struct DayTotal
+{
+    uint32_t account;
+    uint64_t sent;
+    uint64_t received;
+    uint64_t fees;
+};
+
+// The executed transactions summed up per day and account, kept up to date
+// as they are appended in execution order. A day is executeDate / DAY, the
+// same day the s query summarizes. The totals of a day are contiguous, one
+// per account that took part in a transaction that day, so summing a run of
+// whole days costs the accounts active on them rather than the transactions.
+class DailyTotals {
+public:
+    static constexpr uint64_t DAY = 1000000ULL;
+
+    // transaction executes no earlier than the one added before it
+    void add(const Transaction& transaction) {
+        uint64_t day = transaction.executeDate / DAY;
+        if (days.empty() || days.back() != day) {
+            days.push_back(day);
+            dayStart.push_back(totals.size());
+        }
+        unsigned senderFee, recipientFee;
+        splitBankFee(transaction.bankfee, transaction.feeMode, senderFee, recipientFee);
+        DayTotal& sender = today(transaction.sender);
+        sender.sent += transaction.amount;
+        sender.fees += senderFee;
+        DayTotal& recipient = today(transaction.recipient);
+        recipient.received += transaction.amount;
+        recipient.fees += recipientFee;
+    }
+
+    // visits the totals of every day in [firstDay, lastDay)
+    template <typename Visit>
+    void forEachTotal(uint64_t firstDay, uint64_t lastDay, Visit visit) const {
+        size_t from = static_cast<size_t>(std::lower_bound(days.begin(), days.end(), firstDay) - days.begin());
+        size_t to = static_cast<size_t>(std::lower_bound(days.begin(), days.end(), lastDay) - days.begin());
+        if (from >= to) return;
+        size_t end = (to == days.size()) ? totals.size() : dayStart[to];
+        for (size_t i = dayStart[from]; i < end; i++) visit(totals[i]);
+    }
+
+    // drops every total, the containers keep their capacity
+    void clear() {
+        days.clear();
+        dayStart.clear();
+        totals.clear();
+        slot.clear();
+    }
+
+private:
+    static constexpr size_t NO_SLOT = SIZE_MAX;
+
+    std::vector<uint64_t> days; // ascending
+    std::vector<size_t> dayStart; // where the totals of days[k] begin
+    std::vector<DayTotal> totals;
+    std::vector<size_t> slot; // by account, its latest total; one before dayStart.back() is an earlier day's
+
+    DayTotal& today(uint32_t account) {
+        if (account >= slot.size()) slot.resize(account + 1, NO_SLOT);
+        size_t& at = slot[account];
+        if (at == NO_SLOT || at < dayStart.back()) {
+            at = totals.size();
+            totals.push_back({account, 0, 0, 0});
+        }
+        return totals[at];
+    }
+};
+
+#endif
@@ -0,0 +1,81 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef DUE_BATCH_H
+#define DUE_BATCH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "fee.h"
+#include "thread_pool.h"
+#include "transaction.h"
+
+// Splits a batch of transactions, given in execution order, into levels so
+// that the transactions of one level touch pairwise disjoint accounts. A
+// transaction goes one level past the latest transaction before it that
+// shares an account, so every account still sees its own transactions in
+// execution order when the levels are run one after the other.
+class ConflictLevels {
+public:
+    void build(const std::vector<Transaction>& batch, size_t accounts) {
+        if (accountLevel.size() < accounts) accountLevel.resize(accounts, 0);
+        if (++stamp == 0) {
+            // stamps wrapped around, forget every earlier batch
+            std::fill(accountLevel.begin(), accountLevel.end(), 0);
+            stamp = 1;
+        }
+        level.resize(batch.size());
+        levelStart.assign(1, 0);
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            uint32_t sender = batch[i].sender, recipient = batch[i].recipient;
+            uint32_t ans = std::max(next(sender), next(recipient));
+            accountLevel[sender] = accountLevel[recipient] = (uint64_t(stamp) << 32) | ans;
+            level[i] = ans;
+            if (ans + 1 >= levelStart.size()) levelStart.resize(ans + 2, 0);
+            levelStart[ans + 1]++;
+        }
+
+        // counting sort by level, stable so a level keeps execution order
+        for (size_t l = 1; l < levelStart.size(); l++) levelStart[l] += levelStart[l - 1];
+        order.resize(batch.size());
+        std::vector<uint32_t> fill(levelStart.begin(), levelStart.end() - 1);
+        for (size_t i = 0; i < batch.size(); i++) order[fill[level[i]]++] = static_cast<uint32_t>(i);
+    }
+
+    size_t size() const { return levelStart.size() - 1; }
+
+    // indices into the batch of the transactions in level l
+    const uint32_t* begin(size_t l) const { return order.data() + levelStart[l]; }
+    const uint32_t* end(size_t l) const { return order.data() + levelStart[l + 1]; }
+
+private:
+    std::vector<uint64_t> accountLevel; // (stamp << 32) | level of the account's latest transaction
+    uint32_t stamp = 0; // batch number, tells stale accountLevel entries apart
+    std::vector<uint32_t> level;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> levelStart = std::vector<uint32_t>(1, 0);
+
+    uint32_t next(uint32_t account) const {
+        uint64_t entry = accountLevel[account];
+        return (entry >> 32) == stamp ? static_cast<uint32_t>(entry) + 1 : 0;
+    }
+};
+
+// Scratch space of updateToCurrentTimeStamp(), kept between calls so a
+// drain allocates nothing once the vectors have grown.
+struct DueBatch
+{
+    static constexpr size_t PARALLEL_MIN = 4096; // smaller batches, or levels, run serially
+
+    explicit DueBatch(ThreadPool& pool_in) : pool(pool_in) {}
+
+    ThreadPool& pool;
+    std::vector<Transaction> due; // popped in execution order
+    std::vector<uint32_t> senderFee; // per due transaction
+    std::vector<uint32_t> recipientFee;
+    std::vector<unsigned char> succeeded;
+    FeeBlock block;
+    ConflictLevels levels;
+};
+
+#endif
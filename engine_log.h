@@ -0,0 +1,216 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef ENGINE_LOG_H
+#define ENGINE_LOG_H
+
+#include <cstdint>
+#include <fcntl.h>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include "name_table.h"
+#include "output_writer.h"
+#include "transaction.h"
+
+// What the command handlers report besides the answers every run prints.
+// The handlers are templates on one of the log types below and call the
+// same event functions on each, so which of them a run uses is fixed at
+// compile time: QuietLog's are empty and leave no branch or formatting code
+// behind, VerboseLog's print the -v messages, EventLog's write binary
+// records.
+
+// why a command was turned down, as recorded by EventLog
+enum class RejectReason : uint8_t {
+    SELF_TRANSACTION, TOO_FAR_AHEAD, UNKNOWN_SENDER, UNKNOWN_RECIPIENT, NOT_REGISTERED,
+    NOT_LOGGED_IN, FRAUD, // place
+    LOGIN_FAILED, LOGOUT_FAILED, // login, out
+    UNKNOWN_ACCOUNT, BALANCE_NOT_LOGGED_IN, BALANCE_FRAUD // balance
+};
+
+// No -v: none of these events print anything.
+struct QuietLog
+{
+    void placed(const Transaction&, uint64_t, std::string_view, std::string_view, std::string_view, OutputWriter&) {}
+    void executed(const Transaction&, uint32_t, uint32_t, const NameTable&, OutputWriter&) {}
+    void insufficientFunds(const Transaction&, OutputWriter&) {}
+    void placeRejected(RejectReason, uint64_t, uint64_t, std::string_view, std::string_view, const NameTable&, OutputWriter&) {}
+    void loggedIn(std::string_view, uint32_t, uint64_t, OutputWriter&) {}
+    void loggedOut(std::string_view, uint32_t, uint64_t, OutputWriter&) {}
+    void rejected(RejectReason, std::string_view, uint32_t, uint64_t, OutputWriter&) {}
+};
+
+// -v: the log messages of the spec, into the command output.
+struct VerboseLog
+{
+    // amount is printed the way the command spelled it
+    void placed(const Transaction& placed, uint64_t placeTimestamp, std::string_view amount, std::string_view sender, std::string_view recipient, OutputWriter& output) {
+        output << "Transaction " << placed.transactionID << " placed at " << placeTimestamp << ": $" << amount << " from " << sender << " to " << recipient << " at " << placed.executeDate << ".\n";
+    }
+
+    void executed(const Transaction& executed, uint32_t, uint32_t, const NameTable& userNames, OutputWriter& output) {
+        output << "Transaction " << executed.transactionID << " executed at " << executed.executeDate << ": $" << executed.amount << " from " << userNames.name(executed.sender) << " to " << userNames.name(executed.recipient) << ".\n";
+    }
+
+    void insufficientFunds(const Transaction& failed, OutputWriter& output) {
+        output << "Insufficient funds to process transaction " << failed.transactionID << ".\n";
+    }
+
+    void placeRejected(RejectReason reason, uint64_t, uint64_t, std::string_view sender, std::string_view recipient, const NameTable&, OutputWriter& output) {
+        switch (reason) {
+        case RejectReason::SELF_TRANSACTION: output << "Self transactions are not allowed.\n"; break;
+        case RejectReason::TOO_FAR_AHEAD: output << "Select a time up to three days in the future.\n"; break;
+        case RejectReason::UNKNOWN_SENDER: output << "Sender " << sender << " does not exist.\n"; break;
+        case RejectReason::UNKNOWN_RECIPIENT: output << "Recipient " << recipient << " does not exist.\n"; break;
+        case RejectReason::NOT_REGISTERED: output << "At the time of execution, sender and/or recipient have not registered.\n"; break;
+        case RejectReason::NOT_LOGGED_IN: output << "Sender " << sender << " is not logged in.\n"; break;
+        default: output << "Fraudulent transaction detected, aborting request.\n"; break;
+        }
+    }
+
+    void loggedIn(std::string_view name, uint32_t, uint64_t, OutputWriter& output) {
+        output << "User " << name << " logged in.\n";
+    }
+
+    void loggedOut(std::string_view name, uint32_t, uint64_t, OutputWriter& output) {
+        output << "User " << name << " logged out.\n";
+    }
+
+    void rejected(RejectReason reason, std::string_view name, uint32_t, uint64_t, OutputWriter& output) {
+        switch (reason) {
+        case RejectReason::LOGIN_FAILED: output << "Login failed for " << name << ".\n"; break;
+        case RejectReason::LOGOUT_FAILED: output << "Logout failed for " << name << ".\n"; break;
+        case RejectReason::UNKNOWN_ACCOUNT: output << "Account " << name << " does not exist.\n"; break;
+        case RejectReason::BALANCE_NOT_LOGGED_IN: output << "Account " << name << " is not logged in.\n"; break;
+        default: output << "Fraudulent transaction detected, aborting request.\n"; break;
+        }
+    }
+};
+
+enum class EventKind : uint8_t { PLACED, EXECUTED, INSUFFICIENT_FUNDS, REJECTED, LOGGED_IN, LOGGED_OUT };
+
+// One event of an --events file, 48 bytes, little endian. Fields an event
+// has no use for are zero; an account that does not exist is UINT32_MAX.
+//
+//   PLACED              transactionID, timestamp (placed at), when (executes at), account (sender), counterparty, amount, feeMode
+//   EXECUTED            transactionID, timestamp (executed at), account (sender), counterparty, amount, senderFee, recipientFee
+//   INSUFFICIENT_FUNDS  transactionID, timestamp (due at), account (sender), counterparty, amount
+//   REJECTED            reason; a place also timestamp, when, account, counterparty; the others account and ip
+//   LOGGED_IN/OUT       account, ip
+//
+// ip is the SessionStore key: a dotted quad's 32 bit value, bit 32 set and
+// the order in which other address strings were first seen, or UINT64_MAX
+// for an address no session was ever opened from and for a failed login.
+struct EventRecord
+{
+    EventKind kind;
+    RejectReason reason;
+    uint8_t feeMode;
+    uint8_t reserved = 0;
+    uint32_t transactionID;
+    uint64_t timestamp;
+    uint64_t when; // execution date of a placed transaction, or ip
+    uint32_t account;
+    uint32_t counterparty;
+    uint32_t amount;
+    uint32_t senderFee;
+    uint32_t recipientFee;
+    uint32_t padding = 0;
+};
+static_assert(sizeof(EventRecord) == 48, "events are read by offset");
+
+// --events: every event as an EventRecord, after a 16 byte header of the
+// magic "BANKEVT1", the record size and the format version, so the records
+// can be mapped as an array from offset 16. Nothing goes into the command
+// output.
+class EventLog {
+public:
+    static constexpr char MAGIC[8] = {'B', 'A', 'N', 'K', 'E', 'V', 'T', '1'};
+    static constexpr uint32_t VERSION = 1;
+
+    explicit EventLog(const std::string& filename)
+        : fd(open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)), events(fd) {
+        if (fd < 0) throw "Event file failed to open.\n";
+        uint32_t header[2] = {sizeof(EventRecord), VERSION};
+        events << std::string_view(MAGIC, sizeof(MAGIC)) << std::string_view(reinterpret_cast<const char*>(header), sizeof(header));
+    }
+
+    EventLog(const EventLog&) = delete;
+    EventLog& operator=(const EventLog&) = delete;
+
+    ~EventLog() {
+        events.flush();
+        close(fd);
+    }
+
+    void flush() { events.flush(); }
+
+    void placed(const Transaction& placed, uint64_t placeTimestamp, std::string_view, std::string_view, std::string_view, OutputWriter&) {
+        EventRecord record = transaction(EventKind::PLACED, placed, placeTimestamp);
+        record.when = placed.executeDate;
+        record.feeMode = static_cast<uint8_t>(placed.feeMode);
+        write(record);
+    }
+
+    void executed(const Transaction& executed, uint32_t senderFee, uint32_t recipientFee, const NameTable&, OutputWriter&) {
+        EventRecord record = transaction(EventKind::EXECUTED, executed, executed.executeDate);
+        record.senderFee = senderFee;
+        record.recipientFee = recipientFee;
+        write(record);
+    }
+
+    void insufficientFunds(const Transaction& failed, OutputWriter&) {
+        write(transaction(EventKind::INSUFFICIENT_FUNDS, failed, failed.executeDate));
+    }
+
+    // the accounts are only looked up here, so the other logs never pay for it
+    void placeRejected(RejectReason reason, uint64_t placeTimestamp, uint64_t executeTimestamp, std::string_view sender, std::string_view recipient, const NameTable& userNames, OutputWriter&) {
+        EventRecord record = empty(EventKind::REJECTED);
+        record.reason = reason;
+        record.timestamp = placeTimestamp;
+        record.when = executeTimestamp;
+        record.account = userNames.find(sender);
+        record.counterparty = userNames.find(recipient);
+        write(record);
+    }
+
+    void loggedIn(std::string_view, uint32_t id, uint64_t IP, OutputWriter&) { write(session(EventKind::LOGGED_IN, id, IP)); }
+    void loggedOut(std::string_view, uint32_t id, uint64_t IP, OutputWriter&) { write(session(EventKind::LOGGED_OUT, id, IP)); }
+
+    void rejected(RejectReason reason, std::string_view, uint32_t id, uint64_t IP, OutputWriter&) {
+        EventRecord record = session(EventKind::REJECTED, id, IP);
+        record.reason = reason;
+        write(record);
+    }
+
+private:
+    int fd;
+    OutputWriter events;
+
+    static EventRecord empty(EventKind kind) {
+        EventRecord record{};
+        record.kind = kind;
+        return record;
+    }
+
+    static EventRecord transaction(EventKind kind, const Transaction& transaction, uint64_t timestamp) {
+        EventRecord record = empty(kind);
+        record.transactionID = transaction.transactionID;
+        record.timestamp = timestamp;
+        record.account = transaction.sender;
+        record.counterparty = transaction.recipient;
+        record.amount = transaction.amount;
+        return record;
+    }
+
+    static EventRecord session(EventKind kind, uint32_t id, uint64_t IP) {
+        EventRecord record = empty(kind);
+        record.account = id;
+        record.when = IP;
+        return record;
+    }
+
+    void write(const EventRecord& record) {
+        events << std::string_view(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+};
+
+#endif
@@ -0,0 +1,96 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef FEE_H
+#define FEE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "transaction.h"
+
+// The fee is 1% of the amount, at least 10 and at most 450, with a quarter
+// off (rounded down) when the sender registered more than five years
+// (50000000000 timestamp units) before the execution date. FeeMode::SENDER
+// leaves the recipient nothing to pay, FeeMode::SPLIT halves the fee with
+// the odd dollar going to the sender.
+constexpr uint64_t LOYALTY_PERIOD = 50000000000ULL;
+
+inline unsigned calculateBankFee(unsigned int amount, FeeMode feeMode, uint64_t sender_reg_ts, uint64_t execute_ts, bool isSender) {
+    unsigned int ans = amount / 100;
+    ans = std::max(10u, ans);
+    ans = std::min(450u, ans);
+
+    // Then find if discount considered
+    if (execute_ts - sender_reg_ts > LOYALTY_PERIOD)
+    {
+        ans = (ans * 3) / 4;
+    }
+
+    if (!isSender && feeMode == FeeMode::SENDER) {
+        ans = 0;
+    } else if (feeMode == FeeMode::SPLIT) {
+        ans = (ans % 2 == 0) ? ans / 2 : (ans / 2) + (isSender ? 1 : 0);
+    } 
+    
+    return ans;
+}
+
+// the two sides of a recorded bankfee, which is what the sender and the
+// recipient paid together: calculateBankFee() of each, so a split's odd
+// dollar is the sender's and a BOTH fee is twice what either side paid
+inline void splitBankFee(unsigned bankfee, FeeMode feeMode, unsigned& senderFee, unsigned& recipientFee) {
+    if (feeMode == FeeMode::SENDER) {
+        senderFee = bankfee;
+        recipientFee = 0;
+    } else if (feeMode == FeeMode::SPLIT) {
+        senderFee = (bankfee + 1) / 2;
+        recipientFee = bankfee / 2;
+    } else {
+        senderFee = bankfee / 2;
+        recipientFee = bankfee / 2;
+    }
+}
+
+// A block of due transactions laid out as columns, so computeFees() is one
+// branch free loop over plain arrays that the compiler turns into SIMD code.
+struct FeeBlock
+{
+    static constexpr size_t SIZE = 256;
+
+    size_t count = 0;
+    uint32_t amount[SIZE];
+    uint64_t senderRegistered[SIZE];
+    uint64_t executeDate[SIZE];
+    uint32_t mode[SIZE]; // FeeMode, as wide as the other columns
+    uint32_t loyal[SIZE]; // scratch for computeFees()
+    uint32_t senderFee[SIZE];
+    uint32_t recipientFee[SIZE];
+};
+
+// same results as calculateBankFee() for both sides of every transaction in the block
+inline void computeFees(FeeBlock& block) {
+    // baseline x86-64 has no 64 bit vector compare, so the discount test is
+    // its own pass and the fee arithmetic below stays in 32 bit lanes
+    uint32_t* __restrict loyal = block.loyal;
+    for (size_t i = 0; i < block.count; i++) {
+        loyal[i] = (block.executeDate[i] - block.senderRegistered[i] > LOYALTY_PERIOD) ? 1 : 0;
+    }
+
+    const uint32_t* __restrict amount = block.amount;
+    const uint32_t* __restrict mode = block.mode;
+    uint32_t* __restrict senderFee = block.senderFee;
+    uint32_t* __restrict recipientFee = block.recipientFee;
+    for (size_t i = 0; i < block.count; i++)
+    {
+        uint32_t fee = amount[i] / 100;
+        fee = fee < 10 ? 10 : fee;
+        fee = fee > 450 ? 450 : fee;
+        fee = loyal[i] ? (fee * 3) / 4 : fee;
+        uint32_t split = (mode[i] == static_cast<uint32_t>(FeeMode::SPLIT)) ? 1 : 0;
+        uint32_t senderOnly = (mode[i] == static_cast<uint32_t>(FeeMode::SENDER)) ? 1 : 0;
+        // a split rounds the sender's half up and the recipient's down
+        senderFee[i] = split ? (fee + 1) / 2 : fee;
+        recipientFee[i] = senderOnly ? 0 : (split ? fee / 2 : fee);
+    }
+}
+
+#endif
@@ -0,0 +1,284 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "journal.h"
+
+using namespace std;
+
+namespace {
+
+constexpr char JOURNAL_MAGIC[8] = {'2', '8', '1', 'B', 'A', 'N', 'K', 'J'};
+constexpr uint32_t JOURNAL_VERSION = 2; // 2: place records field by field
+
+// what the journal was started on, recovery checks it against the base it is given
+struct JournalHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t userCount;
+    uint64_t pendingCount;
+    uint32_t transactionID;
+    uint32_t transactionIDSuccessed;
+};
+
+JournalHeader headerOf(const BankState& state) {
+    JournalHeader header = {};
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.headerSize = sizeof(JournalHeader);
+    header.userCount = state.users.size();
+    header.pendingCount = state.unexecutedTransactions.size();
+    header.transactionID = state.transactionID;
+    header.transactionIDSuccessed = state.transactionIDSuccessed;
+    return header;
+}
+
+bool writeAll(int fd, const char* data, size_t bytes) {
+    while (bytes != 0)
+    {
+        ssize_t written = write(fd, data, bytes);
+        if (written < 0) return false;
+        data += written;
+        bytes -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// removes the earliest pending transaction, which the record says is transactionID
+Transaction popEarliest(BankState& state, uint32_t transactionID) {
+    Transaction transaction;
+    if (!state.unexecutedTransactions.popDue(UINT64_MAX, transaction) || transaction.transactionID != transactionID) {
+        throw "Journal file is corrupt.\n";
+    }
+    return transaction;
+}
+
+uint32_t userOf(const char* body, size_t bytes, const BankState& state) {
+    uint32_t user;
+    if (bytes < sizeof(user)) throw "Journal file is corrupt.\n";
+    memcpy(&user, body, sizeof(user));
+    if (user >= state.users.size()) throw "Journal file is corrupt.\n";
+    return user;
+}
+
+void apply(Journal::RecordType type, const char* body, size_t bytes, BankState& state, size_t balanceCheckpoint) {
+    switch (type) {
+    case Journal::LOGIN: {
+        uint32_t id = userOf(body, bytes, state);
+        string_view IP(body + 4, bytes - 4);
+        state.sessions.insert(state.users[id].activeSession, id, state.sessions.intern(IP));
+        break;
+    }
+    case Journal::LOGOUT: {
+        uint32_t id = userOf(body, bytes, state);
+        string_view IP(body + 4, bytes - 4);
+        state.sessions.erase(state.users[id].activeSession, id, state.sessions.find(IP));
+        break;
+    }
+    case Journal::CLOCK:
+        if (bytes != sizeof(uint64_t)) throw "Journal file is corrupt.\n";
+        memcpy(&state.recentPlace_timestamp, body, bytes);
+        state.recentPlace_was_set = true;
+        break;
+    case Journal::PLACE: {
+        uint32_t fields[7]; // executeDate low and high word, transactionID, amount, sender, recipient, feeMode
+        if (bytes != sizeof(fields)) throw "Journal file is corrupt.\n";
+        memcpy(fields, body, bytes);
+        if (fields[4] >= state.users.size() || fields[5] >= state.users.size() || fields[6] > static_cast<uint32_t>(FeeMode::SPLIT)) {
+            throw "Journal file is corrupt.\n";
+        }
+        Transaction transaction((uint64_t(fields[1]) << 32) | fields[0], fields[2], fields[3], fields[4], fields[5], static_cast<FeeMode>(fields[6]));
+        transaction.bankfee = 0;
+        state.unexecutedTransactions.push(transaction);
+        state.transactionID = transaction.transactionID + 1;
+        break;
+    }
+    case Journal::EXECUTED: {
+        uint32_t fields[3]; // transactionID, sender fee, recipient fee
+        if (bytes != sizeof(fields)) throw "Journal file is corrupt.\n";
+        memcpy(fields, body, bytes);
+        Transaction transaction = popEarliest(state, fields[0]);
+        transaction.bankfee = fields[1] + fields[2];
+        state.users[transaction.sender].balance -= transaction.amount + fields[1];
+        state.users[transaction.recipient].balance += transaction.amount - fields[2];
+        state.users[transaction.sender].outcoming.push_back(state.transactionIDSuccessed);
+        state.users[transaction.recipient].incoming.push_back(state.transactionIDSuccessed);
+        state.transactionIDSuccessed++;
+        state.transactions.push_back(transaction);
+        state.users[transaction.sender].recordBalance(transaction.executeDate, transaction.amount + fields[1], 0, balanceCheckpoint);
+        state.users[transaction.recipient].recordBalance(transaction.executeDate, fields[2], transaction.amount, balanceCheckpoint);
+        break;
+    }
+    case Journal::FAILED: {
+        uint32_t transactionID;
+        if (bytes != sizeof(transactionID)) throw "Journal file is corrupt.\n";
+        memcpy(&transactionID, body, bytes);
+        popEarliest(state, transactionID);
+        break;
+    }
+    default:
+        throw "Journal file is corrupt.\n";
+    }
+}
+
+} // namespace
+
+Journal::~Journal() {
+    try
+    {
+        close();
+    }
+    catch (const char*)
+    {
+        // nothing left to report it to, main closes the journal itself on the way out
+    }
+}
+
+void Journal::create(const string& filename, const BankState& state, size_t groupSize_in) {
+    fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw "Journal file failed to open.\n";
+    }
+    JournalHeader header = headerOf(state);
+    if (!writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) || fdatasync(fd) != 0) {
+        ::close(fd);
+        fd = -1;
+        throw "Journal file failed to write.\n";
+    }
+    start(groupSize_in);
+}
+
+void Journal::append(const string& filename, uint64_t validBytes, size_t groupSize_in) {
+    fd = open(filename.c_str(), O_WRONLY);
+    if (fd < 0) {
+        throw "Journal file failed to open.\n";
+    }
+    // drop the torn tail of the crashed run before anything follows it
+    if (ftruncate(fd, static_cast<off_t>(validBytes)) != 0 || lseek(fd, 0, SEEK_END) < 0) {
+        ::close(fd);
+        fd = -1;
+        throw "Journal file failed to write.\n";
+    }
+    start(groupSize_in);
+}
+
+void Journal::start(size_t groupSize_in) {
+    groupSize = groupSize_in;
+    writer = thread([this] { writeLoop(); });
+}
+
+void Journal::commit() {
+    uncommitted = 0;
+    unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return !pendingWrite; });
+    if (writeFailed) {
+        throw "Journal file failed to write.\n";
+    }
+    if (filling.empty()) return;
+    swap(filling, writing);
+    filling.clear();
+    pendingWrite = true;
+    wake.notify_one();
+}
+
+void Journal::writeLoop() {
+    unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this] { return pendingWrite || stopping; });
+        if (!pendingWrite) return;
+        lock.unlock();
+        bool written = writeAll(fd, writing.data(), writing.size()) && fdatasync(fd) == 0;
+        lock.lock();
+        writeFailed = writeFailed || !written;
+        pendingWrite = false;
+        idle.notify_all();
+    }
+}
+
+void Journal::close() {
+    if (fd < 0) return;
+    bool failed = false;
+    try
+    {
+        commit();
+        unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return !pendingWrite; });
+        failed = writeFailed;
+    }
+    catch (const char*)
+    {
+        failed = true;
+    }
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    ::close(fd);
+    fd = -1;
+    if (failed) {
+        throw "Journal file failed to write.\n";
+    }
+}
+
+uint64_t replayJournal(const string& filename, BankState& state, size_t balanceCheckpoint) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw "Journal file failed to open.\n";
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(JournalHeader)) {
+        close(fd);
+        throw "Journal file is corrupt.\n";
+    }
+    size_t fileSize = static_cast<size_t>(st.st_size);
+    void* addr = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw "Journal file failed to open.\n";
+    }
+    const char* data = static_cast<const char*>(addr);
+
+    size_t pos = sizeof(JournalHeader);
+    try
+    {
+        JournalHeader header;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 || header.headerSize != sizeof(JournalHeader)) {
+            throw "Journal file is corrupt.\n";
+        }
+        if (header.version != JOURNAL_VERSION) {
+            throw "Journal version is not supported.\n";
+        }
+        JournalHeader expected = headerOf(state);
+        if (header.userCount != expected.userCount || header.pendingCount != expected.pendingCount
+            || header.transactionID != expected.transactionID || header.transactionIDSuccessed != expected.transactionIDSuccessed) {
+            throw "Journal was not started on this registration data.\n";
+        }
+
+        while (fileSize - pos >= 8)
+        {
+            uint32_t length, sum;
+            memcpy(&length, data + pos, 4);
+            memcpy(&sum, data + pos + 4, 4);
+            const char* body = data + pos + 8;
+            // a crash can leave the last records cut short or half written
+            if (length == 0 || length > fileSize - pos - 8 || Journal::recordChecksum(body, length) != sum) break;
+            apply(static_cast<Journal::RecordType>(body[0]), body + 1, length - 1, state, balanceCheckpoint);
+            pos += 8 + length;
+        }
+    }
+    catch (const char*)
+    {
+        munmap(addr, fileSize);
+        throw;
+    }
+    munmap(addr, fileSize);
+    return pos;
+}
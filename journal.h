@@ -0,0 +1,139 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "bank_state.h"
+#include "transaction.h"
+
+// Write-ahead journal of every change the command loop makes to a BankState:
+// logins, logouts, the placement clock, accepted places and the outcome of
+// every executed transaction, in the order they happen. Replaying it on top
+// of the same registration file (or snapshot) rebuilds the state without
+// running a single check or fee computation again.
+//
+// Records are appended to a memory buffer. Every groupSize commands the
+// buffer is handed to a background thread that writes it and fdatasync()s
+// the file, while the command loop fills the other buffer; the loop only
+// waits when it fills a group before the previous fsync is done. A crash
+// loses at most the last two groups, and the torn tail it leaves behind is
+// recognised by the record checksums and cut off on recovery.
+class Journal {
+public:
+    static constexpr size_t DEFAULT_GROUP = 256; // commands per fsync
+
+    Journal() = default;
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // starts a new journal on top of state, as it is before any command ran
+    void create(const std::string& filename, const BankState& state, size_t groupSize_in);
+    // appends to a journal that replayJournal() read validBytes of
+    void append(const std::string& filename, uint64_t validBytes, size_t groupSize_in);
+    // commits what is buffered, waits for it to be on disk and stops the writer thread
+    void close();
+
+    bool active() const { return fd >= 0; }
+
+    void login(uint32_t user, std::string_view IP) {
+        if (active()) record(LOGIN, &user, sizeof(user), IP);
+    }
+
+    void logout(uint32_t user, std::string_view IP) {
+        if (active()) record(LOGOUT, &user, sizeof(user), IP);
+    }
+
+    // the placement timestamp moved, balance reports it
+    void clock(uint64_t timestamp) {
+        if (active()) record(CLOCK, &timestamp, sizeof(timestamp));
+    }
+
+    // field by field, so the record has no padding and does not depend on the layout of Transaction
+    void place(const Transaction& transaction) {
+        if (!active()) return;
+        uint32_t body[7] = {static_cast<uint32_t>(transaction.executeDate), static_cast<uint32_t>(transaction.executeDate >> 32),
+                            transaction.transactionID, transaction.amount, transaction.sender, transaction.recipient,
+                            static_cast<uint32_t>(transaction.feeMode)};
+        record(PLACE, body, sizeof(body));
+    }
+
+    // the earliest pending transaction went through with these fees
+    void executed(uint32_t transactionID, uint32_t senderFee, uint32_t recipientFee) {
+        if (!active()) return;
+        uint32_t body[3] = {transactionID, senderFee, recipientFee};
+        record(EXECUTED, body, sizeof(body));
+    }
+
+    // the earliest pending transaction was dropped for insufficient funds
+    void failed(uint32_t transactionID) {
+        if (active()) record(FAILED, &transactionID, sizeof(transactionID));
+    }
+
+    void endCommand() {
+        if (active() && ++uncommitted >= groupSize) commit();
+    }
+
+    // commits what is buffered without waiting for the group to fill, for when input goes quiet
+    void flush() {
+        if (active() && !filling.empty()) commit();
+    }
+
+    enum RecordType : uint8_t { LOGIN = 1, LOGOUT, CLOCK, PLACE, EXECUTED, FAILED };
+
+    // FNV-1a, the records are too short for anything wider to pay off
+    static uint32_t recordChecksum(const char* data, size_t bytes) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < bytes; i++) hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+        return hash;
+    }
+
+private:
+    int fd = -1;
+    size_t groupSize = DEFAULT_GROUP;
+    size_t uncommitted = 0; // commands since the last commit
+    std::vector<char> filling;
+    std::vector<char> writing; // owned by the writer thread while pendingWrite
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool pendingWrite = false;
+    bool stopping = false;
+    bool writeFailed = false;
+
+    // every record is the length of its body, a checksum of the body, then
+    // the body: the type, the fixed size fields and the text of a session IP
+    void record(RecordType type, const void* data, size_t bytes, std::string_view text = {}) {
+        uint32_t length = static_cast<uint32_t>(1 + bytes + text.size());
+        size_t start = filling.size();
+        filling.resize(start + 8 + length);
+        char* out = filling.data() + start;
+        out[8] = static_cast<char>(type);
+        memcpy(out + 9, data, bytes);
+        if (!text.empty()) memcpy(out + 9 + bytes, text.data(), text.size());
+        uint32_t sum = recordChecksum(out + 8, length);
+        memcpy(out, &length, 4);
+        memcpy(out + 4, &sum, 4);
+    }
+
+    void start(size_t groupSize_in);
+    void commit();
+    void writeLoop();
+};
+
+// Applies the journal to state, which must hold what the journal was
+// started on. Returns the length of the intact part of the file: a record
+// cut short or failing its checksum ends the replay there. The balance
+// histories get a checkpoint every balanceCheckpoint entries.
+uint64_t replayJournal(const std::string& filename, BankState& state, size_t balanceCheckpoint);
+
+#endif
@@ -0,0 +1,48 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef NAME_TABLE_H
+#define NAME_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+// Interns account names into dense ids 0, 1, 2, ... in registration order.
+// Names are resolved once when a command is read; everything behind that
+// works with the id and only goes back to the name for output.
+class NameTable {
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    uint32_t find(std::string_view name) const {
+        auto iter = ids.find(name);
+        return (iter == ids.end()) ? NOT_FOUND : iter->second;
+    }
+
+    // returns the id of name and whether it was newly added
+    std::pair<uint32_t, bool> intern(std::string_view name) {
+        if (auto iter = ids.find(name); iter != ids.end()) return {iter->second, false};
+        uint32_t id = static_cast<uint32_t>(names.size());
+        names.emplace_back(name);
+        ids.emplace(names.back(), id);
+        return {id, true};
+    }
+
+    std::string_view name(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+    void reserve(size_t n) { ids.reserve(n); }
+
+    // forgets every name, the hash table keeps its buckets for the next use
+    void clear() {
+        ids.clear();
+        names.clear();
+    }
+
+private:
+    std::deque<std::string> names; // a deque never moves its elements, so the keys below stay valid
+    std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+#endif
@@ -0,0 +1,98 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <unistd.h>
+
+// Buffered replacement for cout. Integers are formatted with to_chars
+// straight into the buffer and nothing is allocated per call.
+//
+// Flush policy: the buffer goes out when it cannot take the next piece, when
+// endCommand() is called on a terminal (so interactive use still sees every
+// reply), and on destruction. A writer built without a file descriptor only
+// collects output in memory and never flushes on its own.
+class OutputWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    explicit OutputWriter(int fd_in = -1, size_t capacity = BUFFER_SIZE) 
+        : fd(fd_in), interactive(fd_in >= 0 && isatty(fd_in)) {
+        buffer.resize(capacity);
+    }
+
+    ~OutputWriter() { flush(); }
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    OutputWriter& operator<<(std::string_view str) {
+        append(str.data(), str.size());
+        return *this;
+    }
+
+    OutputWriter& operator<<(const char* str) { return *this << std::string_view(str); }
+
+    OutputWriter& operator<<(char c) {
+        reserve(1);
+        buffer[used++] = c;
+        return *this;
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+    OutputWriter& operator<<(T value) {
+        reserve(MAX_DIGITS);
+        auto result = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value);
+        used = static_cast<size_t>(result.ptr - buffer.data());
+        return *this;
+    }
+
+    void endCommand() {
+        if (interactive) flush();
+    }
+
+    void flush() {
+        if (fd < 0) return;
+        size_t done = 0;
+        while (done < used)
+        {
+            ssize_t n = ::write(fd, buffer.data() + done, used - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break; // like a failed cout, later output is dropped
+            done += static_cast<size_t>(n);
+        }
+        used = 0;
+    }
+
+    // in memory writers only
+    std::string_view view() const { return std::string_view(buffer.data(), used); }
+    void clear() { used = 0; }
+
+private:
+    static constexpr size_t MAX_DIGITS = 20; // UINT64_MAX
+
+    int fd;
+    bool interactive;
+    std::vector<char> buffer;
+    size_t used = 0;
+
+    void reserve(size_t n) {
+        if (buffer.size() - used >= n) return;
+        flush();
+        if (buffer.size() - used < n) buffer.resize(std::max(buffer.size() * 2, used + n));
+    }
+
+    void append(const char* data, size_t n) {
+        reserve(n);
+        memcpy(buffer.data() + used, data, n);
+        used += n;
+    }
+};
+
+#endif
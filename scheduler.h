@@ -0,0 +1,156 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "transaction.h"
+
+// Pending transactions bucketed by executeDate (a timing wheel).
+//
+// place() only accepts an execution date at most 3000000 past the placement
+// timestamp, and placements never go back in time, so every pending
+// transaction falls inside a window of BUCKET_COUNT buckets starting at the
+// cursor. push() appends to the bucket of its executeDate in O(1); a bucket
+// is only sorted once it becomes the cursor bucket, so popDue() hands out
+// transactions in exactly SortByExecuteDate order. Anything outside the
+// window (never produced by place(), kept for safety) waits in a small heap
+// that popDue() also checks.
+class CalendarQueue {
+public:
+    static constexpr unsigned BUCKET_SHIFT = 8; // 256 timestamp units per bucket
+    static constexpr uint64_t BUCKET_COUNT = 1 << 14; // 16384 * 256 > 3000000
+
+    CalendarQueue() : buckets(BUCKET_COUNT) {}
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    // drops everything pending, the buckets keep their storage
+    void clear() {
+        for (Bucket& bucket : buckets) {
+            bucket.items.clear();
+            bucket.head = 0;
+            bucket.sorted = true;
+        }
+        overflow.clear();
+        cursor = last = 0;
+        count = 0;
+    }
+
+    void push(const Transaction& transaction) {
+        uint64_t index = transaction.executeDate >> BUCKET_SHIFT;
+        if (count == 0) {
+            // nothing pending, restart the window at this transaction
+            Bucket& bucket = buckets[cursor & (BUCKET_COUNT - 1)];
+            bucket.items.clear();
+            bucket.head = 0;
+            cursor = last = index;
+        } else if (index < cursor && last < index + BUCKET_COUNT) {
+            // slide the window back, nothing falls off its far end
+            cursor = index;
+        }
+        count++;
+        if (index < cursor || index >= cursor + BUCKET_COUNT) {
+            overflow.push_back(transaction);
+            std::push_heap(overflow.begin(), overflow.end(), SortByExecuteDate());
+            return;
+        }
+        insert(index, transaction);
+    }
+
+    // moves the earliest pending transaction into out if it executes at or before timestamp
+    bool popDue(uint64_t timestamp, Transaction& out) {
+        while (count != 0)
+        {
+            Bucket& bucket = buckets[cursor & (BUCKET_COUNT - 1)];
+            if (bucket.head < bucket.items.size()) {
+                if (!bucket.sorted) {
+                    std::sort(bucket.items.begin() + static_cast<std::ptrdiff_t>(bucket.head), bucket.items.end(), SortEarliestFirst());
+                    bucket.sorted = true;
+                }
+                const Transaction& front = bucket.items[bucket.head];
+                if (!overflow.empty() && SortByExecuteDate()(front, overflow.front())) return popOverflow(timestamp, out);
+                if (front.executeDate > timestamp) return false;
+                out = front;
+                bucket.head++;
+                count--;
+                return true;
+            }
+            bucket.items.clear();
+            bucket.head = 0;
+
+            // left behind the cursor, it goes before anything in the wheel
+            if (!overflow.empty() && (overflow.front().executeDate >> BUCKET_SHIFT) <= cursor) return popOverflow(timestamp, out);
+            // the next bucket cannot hold anything due yet
+            if (((cursor + 1) << BUCKET_SHIFT) > timestamp) return false;
+            if (count == overflow.size()) {
+                // the wheel is empty, jump straight to the next overflow transaction
+                cursor = std::max(cursor + 1, overflow.front().executeDate >> BUCKET_SHIFT);
+            } else {
+                cursor++;
+            }
+            refillFromOverflow();
+        }
+        return false;
+    }
+
+    // visits every pending transaction, in no particular order
+    template <typename Function>
+    void forEach(Function visit) const {
+        for (const Bucket& bucket : buckets) {
+            for (size_t i = bucket.head; i < bucket.items.size(); i++) visit(bucket.items[i]);
+        }
+        for (const Transaction& transaction : overflow) visit(transaction);
+    }
+
+private:
+    struct Bucket {
+        std::vector<Transaction> items;
+        size_t head = 0; // items before head are already handed out
+        bool sorted = true;
+    };
+
+    struct SortEarliestFirst {
+        bool operator()(const Transaction &left, const Transaction &right) const {
+            return SortByExecuteDate()(right, left);
+        }
+    };
+
+    std::vector<Bucket> buckets;
+    std::vector<Transaction> overflow; // a heap ordered by SortByExecuteDate
+    uint64_t cursor = 0; // absolute bucket index, every pending transaction is at or after it
+    uint64_t last = 0; // no bucket past this one holds anything
+    size_t count = 0;
+
+    void insert(uint64_t index, const Transaction& transaction) {
+        Bucket& bucket = buckets[index & (BUCKET_COUNT - 1)];
+        last = std::max(last, index);
+        if (bucket.sorted && bucket.head < bucket.items.size()
+            && SortByExecuteDate()(bucket.items.back(), transaction)) {
+            bucket.sorted = false;
+        }
+        bucket.items.push_back(transaction);
+    }
+
+    bool popOverflow(uint64_t timestamp, Transaction& out) {
+        if (overflow.front().executeDate > timestamp) return false;
+        out = overflow.front();
+        std::pop_heap(overflow.begin(), overflow.end(), SortByExecuteDate());
+        overflow.pop_back();
+        count--;
+        return true;
+    }
+
+    void refillFromOverflow() {
+        while (!overflow.empty() && (overflow.front().executeDate >> BUCKET_SHIFT) < cursor + BUCKET_COUNT)
+        {
+            insert(overflow.front().executeDate >> BUCKET_SHIFT, overflow.front());
+            std::pop_heap(overflow.begin(), overflow.end(), SortByExecuteDate());
+            overflow.pop_back();
+        }
+    }
+};
+
+#endif
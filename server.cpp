@@ -0,0 +1,252 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.h"
+
+using namespace std;
+
+namespace {
+
+int stopWriter = -1; // the write end of the running server's stop pipe
+
+void requestStop(int) {
+    if (stopWriter >= 0) {
+        char byte = 0;
+        ssize_t ignored = write(stopWriter, &byte, 1);
+        (void)ignored;
+    }
+}
+
+sockaddr_un addressOf(const string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw "Socket path is empty or too long.\n";
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// whether a server is accepting connections on address
+bool inUse(const sockaddr_un& address) {
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) return true;
+    bool answered = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    bool refused = !answered && (errno == ECONNREFUSED || errno == ENOENT);
+    close(probe);
+    return !refused;
+}
+
+} // namespace
+
+CommandServer::CommandServer(const string& path_in) : path(path_in) {
+    sockaddr_un address = addressOf(path);
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        throw "Socket failed to open.\n";
+    }
+    int bound = ::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    if (bound != 0 && errno == EADDRINUSE && !inUse(address)) {
+        // left behind by a server that did not shut down, nobody is listening on it
+        unlink(path.c_str());
+        bound = ::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    }
+    if (bound != 0 || listen(listener, SOMAXCONN) != 0) {
+        int error = errno;
+        close(listener);
+        throw (error == EADDRINUSE) ? "Socket is already in use by another server.\n" : "Socket failed to open.\n";
+    }
+
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll < 0 || pipe2(stopPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        if (epoll >= 0) close(epoll);
+        close(listener);
+        unlink(path.c_str());
+        throw "Socket failed to open.\n";
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+    event.data.fd = stopPipe[0];
+    epoll_ctl(epoll, EPOLL_CTL_ADD, stopPipe[0], &event);
+}
+
+CommandServer::~CommandServer() {
+    for (auto& entry : clients) close(entry.first);
+    close(listener);
+    close(epoll);
+    close(stopPipe[0]);
+    close(stopPipe[1]);
+    unlink(path.c_str());
+}
+
+void CommandServer::run(const Handler& handle, const IdleHandler& idle) {
+    stopWriter = stopPipe[1];
+    struct sigaction action = {};
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    struct sigaction oldInterrupt, oldTerminate;
+    sigaction(SIGINT, &action, &oldInterrupt);
+    sigaction(SIGTERM, &action, &oldTerminate);
+
+    constexpr int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+    bool stopping = false;
+    while (!stopping)
+    {
+        int ready = epoll_wait(epoll, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < ready; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listener) {
+                accept();
+                continue;
+            }
+            if (fd == stopPipe[0]) {
+                stopping = true;
+                continue;
+            }
+            auto found = clients.find(fd);
+            if (found == clients.end()) continue; // dropped earlier in this round
+            Client& client = *found->second;
+            if (events[i].events & EPOLLERR) {
+                drop(client);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP)) {
+                read(client, handle);
+            }
+            if (clients.count(fd) != 0 && send(client)) watch(client);
+        }
+        idle();
+    }
+
+    // what is already answered still goes out, as far as it can without waiting
+    vector<int> open;
+    for (auto& entry : clients) open.push_back(entry.first);
+    for (int fd : open) send(*clients[fd]);
+    sigaction(SIGINT, &oldInterrupt, nullptr);
+    sigaction(SIGTERM, &oldTerminate, nullptr);
+    stopWriter = -1;
+}
+
+void CommandServer::accept() {
+    while (true)
+    {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return; // EAGAIN, or out of descriptors until a client leaves
+        }
+        Client& client = *clients.emplace(fd, make_unique<Client>()).first->second;
+        client.fd = fd;
+        watch(client);
+    }
+}
+
+void CommandServer::read(Client& client, const Handler& handle) {
+    // take what is there now, a bounded amount so one client cannot starve the others
+    constexpr size_t CHUNK = 1 << 16;
+    for (size_t total = 0; total < 16 * CHUNK && !client.closing;)
+    {
+        size_t start = client.input.size();
+        client.input.resize(start + CHUNK);
+        ssize_t n = ::read(client.fd, client.input.data() + start, CHUNK);
+        client.input.resize(start + static_cast<size_t>(max<ssize_t>(n, 0)));
+        if (n > 0) {
+            total += static_cast<size_t>(n);
+        } else if (n == 0) {
+            client.closing = true;
+        } else if (errno != EINTR) {
+            if (errno != EAGAIN) client.closing = true;
+            break;
+        }
+    }
+
+    string_view text(client.input.data(), client.input.size());
+    size_t used = 0;
+    while (true)
+    {
+        size_t end = text.find('\n', used);
+        if (end == string_view::npos) break;
+        handleLine(text.substr(used, end - used), handle);
+        used = end + 1;
+    }
+    // like the last line of a file, a last line without a newline still counts
+    if (client.closing && used < text.size()) {
+        handleLine(text.substr(used), handle);
+        used = text.size();
+    }
+    client.input.erase(client.input.begin(), client.input.begin() + static_cast<ptrdiff_t>(used));
+
+    client.pending.insert(client.pending.end(), reply.view().begin(), reply.view().end());
+    reply.clear();
+    if (client.input.size() > MAX_LINE) drop(client);
+}
+
+void CommandServer::handleLine(string_view line, const Handler& handle) {
+    CommandFields fields;
+    tokenize(line, fields);
+    if (fields.count == 0) return;
+    handle(line, fields, reply);
+    reply << '\n';
+}
+
+// writes what it can of the pending replies; false if the client is gone
+bool CommandServer::send(Client& client) {
+    while (client.sent < client.pending.size())
+    {
+        ssize_t n = ::send(client.fd, client.pending.data() + client.sent, client.pending.size() - client.sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            client.sent += static_cast<size_t>(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && errno == EAGAIN) {
+            break;
+        } else {
+            drop(client);
+            return false;
+        }
+    }
+    if (client.sent == client.pending.size()) {
+        client.pending.clear();
+        client.sent = 0;
+        if (client.closing) {
+            drop(client);
+            return false;
+        }
+    }
+    return true;
+}
+
+// reads while the client keeps up with its replies, waits for room to write while any are left
+void CommandServer::watch(Client& client) {
+    uint32_t events = 0;
+    if (!client.closing && client.pending.size() - client.sent < MAX_PENDING) events |= EPOLLIN;
+    if (client.sent < client.pending.size()) events |= EPOLLOUT;
+    if (client.registered && events == client.events) return;
+    epoll_event event = {};
+    event.events = events; // hangups and errors are reported either way
+    event.data.fd = client.fd;
+    epoll_ctl(epoll, client.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, client.fd, &event);
+    client.registered = true;
+    client.events = events;
+}
+
+void CommandServer::drop(Client& client) {
+    int fd = client.fd;
+    epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    clients.erase(fd);
+}
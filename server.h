@@ -0,0 +1,72 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "command_reader.h"
+#include "output_writer.h"
+
+// Serves the command language to any number of local clients over a Unix
+// domain stream socket, from a single thread driven by epoll.
+//
+// A client sends command lines exactly as in a command file and may send
+// as many as it likes before reading any reply. Every line is handed to the
+// handler as soon as it is complete, one line at a time across all clients,
+// so the engine sees a single total order. The replies to everything a
+// client sent in one read go back in one write: the output of each command
+// followed by an empty line, which no command ever prints, so a client can
+// tell where each reply ends even for commands that print nothing.
+//
+// A client that stops reading its replies is not read from either until it
+// catches up. run() returns on SIGINT or SIGTERM.
+class CommandServer {
+public:
+    using Handler = std::function<void(std::string_view line, const CommandFields& fields, OutputWriter& reply)>;
+    using IdleHandler = std::function<void()>;
+
+    static constexpr size_t MAX_LINE = 1 << 16; // longer lines drop the client
+    static constexpr size_t MAX_PENDING = 1 << 22; // unsent reply bytes before reading pauses
+
+    explicit CommandServer(const std::string& path_in);
+    ~CommandServer();
+
+    CommandServer(const CommandServer&) = delete;
+    CommandServer& operator=(const CommandServer&) = delete;
+
+    // serves until a stop signal; idle runs whenever every ready event is handled
+    void run(const Handler& handle, const IdleHandler& idle);
+
+private:
+    struct Client
+    {
+        int fd;
+        std::vector<char> input; // an unfinished line
+        std::vector<char> pending; // replies not sent yet, from sent on
+        size_t sent = 0;
+        bool closing = false; // the client is done sending
+        bool registered = false; // with epoll
+        uint32_t events = 0; // what epoll watches for
+    };
+
+    std::string path;
+    int listener = -1;
+    int epoll = -1;
+    int stopPipe[2] = {-1, -1};
+    std::unordered_map<int, std::unique_ptr<Client>> clients;
+    OutputWriter reply{-1, 1 << 16};
+
+    void accept();
+    void read(Client& client, const Handler& handle);
+    void handleLine(std::string_view line, const Handler& handle);
+    bool send(Client& client);
+    void watch(Client& client);
+    void drop(Client& client);
+};
+
+#endif
@@ -0,0 +1,194 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "name_table.h"
+
+// Active sessions of one account. The first INLINE addresses sit right in
+// the User, so an idle account costs 24 bytes and no allocation; the rest
+// spill into the SessionStore table.
+struct Sessions
+{
+    static constexpr unsigned INLINE = 2;
+    uint64_t ip[INLINE];
+    uint32_t inlineCount = 0;
+    uint32_t count = 0; // inline and spilled
+
+    bool empty() const { return count == 0; }
+};
+
+// IP addresses are turned into 64 bit keys when a command is read: a dotted
+// quad in canonical form (no leading zeros, parts up to 255) is its 32 bit
+// value, any other string gets an id from a string table with bit 32 set, so
+// two addresses match exactly when their strings do.
+//
+// Spilled sessions live in one open addressing table keyed by (account id,
+// key) with linear probing and backward shift deletion.
+class SessionStore {
+public:
+    static constexpr uint64_t NO_KEY = UINT64_MAX; // never logged in from anywhere
+
+    // key of IP, adding it to the string table if needed (login)
+    uint64_t intern(std::string_view IP) {
+        uint32_t value;
+        if (parseIPv4(IP, value)) return value;
+        return OTHER | otherIPs.intern(IP).first;
+    }
+
+    // key of IP, or NO_KEY if no session was ever opened from it
+    uint64_t find(std::string_view IP) const {
+        uint32_t value;
+        if (parseIPv4(IP, value)) return value;
+        uint32_t id = otherIPs.find(IP);
+        return (id == NameTable::NOT_FOUND) ? NO_KEY : (OTHER | id);
+    }
+
+    // the IP string a key was made from
+    std::string address(uint64_t key) const {
+        if (key & OTHER) return std::string(otherIPs.name(static_cast<uint32_t>(key)));
+        std::string ans;
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            ans += std::to_string((key >> shift) & 0xFF);
+            if (shift != 0) ans += '.';
+        }
+        return ans;
+    }
+
+    bool contains(const Sessions& sessions, uint32_t user, uint64_t key) const {
+        if (key == NO_KEY) return false;
+        for (uint32_t i = 0; i < sessions.inlineCount; i++) {
+            if (sessions.ip[i] == key) return true;
+        }
+        return sessions.count != sessions.inlineCount && slotOf(user, key) != NOT_FOUND;
+    }
+
+    // returns false if the session was already open
+    bool insert(Sessions& sessions, uint32_t user, uint64_t key) {
+        if (contains(sessions, user, key)) return false;
+        sessions.count++;
+        if (sessions.inlineCount < Sessions::INLINE) {
+            sessions.ip[sessions.inlineCount++] = key;
+            return true;
+        }
+        if ((used + 1) * 4 > table.size() * 3) grow();
+        place(Entry{key, user});
+        used++;
+        return true;
+    }
+
+    // returns false if there was no such session
+    bool erase(Sessions& sessions, uint32_t user, uint64_t key) {
+        if (key == NO_KEY) return false;
+        for (uint32_t i = 0; i < sessions.inlineCount; i++) {
+            if (sessions.ip[i] == key) {
+                sessions.ip[i] = sessions.ip[--sessions.inlineCount];
+                sessions.count--;
+                return true;
+            }
+        }
+        if (sessions.count == sessions.inlineCount) return false;
+        size_t slot = slotOf(user, key);
+        if (slot == NOT_FOUND) return false;
+        remove(slot);
+        used--;
+        sessions.count--;
+        return true;
+    }
+
+    // closes every session and forgets every address, keeping the table's size
+    void clear() {
+        otherIPs.clear();
+        std::fill(table.begin(), table.end(), Entry());
+        used = 0;
+    }
+
+    // visits (account id, key) of every session that did not fit inline, in no particular order
+    template <typename Function>
+    void forEachSpilled(Function visit) const {
+        for (const Entry& entry : table) {
+            if (entry.key != EMPTY) visit(entry.user, entry.key);
+        }
+    }
+
+    static bool parseIPv4(std::string_view IP, uint32_t& value) {
+        value = 0;
+        size_t i = 0;
+        for (int part = 0; part < 4; part++)
+        {
+            if (part != 0) {
+                if (i == IP.size() || IP[i] != '.') return false;
+                i++;
+            }
+            size_t start = i;
+            unsigned octet = 0;
+            while (i < IP.size() && i - start < 3 && IP[i] >= '0' && IP[i] <= '9') octet = octet * 10 + static_cast<unsigned>(IP[i++] - '0');
+            if (i == start || octet > 255 || (IP[start] == '0' && i - start > 1)) return false;
+            value = (value << 8) | octet;
+        }
+        return i == IP.size();
+    }
+
+private:
+    static constexpr uint64_t OTHER = uint64_t(1) << 32;
+    static constexpr uint64_t EMPTY = UINT64_MAX;
+    static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+    struct Entry
+    {
+        uint64_t key = EMPTY;
+        uint32_t user = 0;
+    };
+
+    NameTable otherIPs;
+    std::vector<Entry> table; // size is zero or a power of two
+    size_t used = 0;
+
+    size_t home(uint32_t user, uint64_t key) const {
+        uint64_t hash = (key ^ (uint64_t(user) << 40) ^ user) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>(hash >> 32) & (table.size() - 1);
+    }
+
+    size_t slotOf(uint32_t user, uint64_t key) const {
+        if (table.empty()) return NOT_FOUND;
+        for (size_t slot = home(user, key); table[slot].key != EMPTY; slot = (slot + 1) & (table.size() - 1)) {
+            if (table[slot].key == key && table[slot].user == user) return slot;
+        }
+        return NOT_FOUND;
+    }
+
+    void place(const Entry& entry) {
+        size_t slot = home(entry.user, entry.key);
+        while (table[slot].key != EMPTY) slot = (slot + 1) & (table.size() - 1);
+        table[slot] = entry;
+    }
+
+    void grow() {
+        std::vector<Entry> old(std::max<size_t>(table.size() * 2, 64));
+        old.swap(table);
+        for (const Entry& entry : old) {
+            if (entry.key != EMPTY) place(entry);
+        }
+    }
+
+    // pulls back every later entry of the probe run that may move into the hole
+    void remove(size_t hole) {
+        const size_t mask = table.size() - 1;
+        for (size_t slot = (hole + 1) & mask; table[slot].key != EMPTY; slot = (slot + 1) & mask)
+        {
+            size_t want = home(table[slot].user, table[slot].key);
+            // the entry can fill the hole unless its home lies in (hole, slot]
+            if (((slot - want) & mask) >= ((slot - hole) & mask)) {
+                table[hole] = table[slot];
+                hole = slot;
+            }
+        }
+        table[hole] = Entry();
+    }
+};
+
+#endif
@@ -0,0 +1,379 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.h"
+
+using namespace std;
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'2', '8', '1', 'B', 'A', 'N', 'K', 'S'};
+constexpr uint32_t SNAPSHOT_VERSION = 6; // 2: Transaction::feeMode is a FeeMode, 3: executed transactions by column, 4: balance histories, 5: pending transactions field by field, 6: no balance checkpoint for idle accounts
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t payloadSize;
+    uint64_t checksum;
+    uint64_t userCount;
+    uint64_t pendingCount;
+    uint64_t transactionCount;
+    uint64_t historyCount; // incoming and outcoming indices of all users
+    uint64_t sessionCount;
+    uint64_t stringBytes;
+    uint64_t checkpointCount; // balance history checkpoints of all users
+    uint64_t balanceBytes; // encoded balance history entries of all users
+    uint64_t recentPlace_timestamp;
+    uint32_t transactionID;
+    uint32_t transactionIDSuccessed;
+    uint32_t recentPlace_was_set;
+    uint32_t reserved;
+};
+
+struct UserRecord
+{
+    uint64_t reg_timestamp;
+    uint64_t stringOffset; // name, pin and session IPs back to back
+    uint32_t balance;
+    uint32_t nameLength;
+    uint32_t pinLength;
+    uint32_t sessionCount; // lengths of the IPs are in the session section
+    uint32_t incomingCount;
+    uint32_t outcomingCount;
+    uint32_t checkpointCount;
+    uint32_t balanceBytes;
+};
+
+// a pending transaction, without the padding of Transaction or the bankfee it does not have yet
+struct PendingRecord
+{
+    uint64_t executeDate;
+    uint32_t transactionID;
+    uint32_t amount;
+    uint32_t sender;
+    uint32_t recipient;
+    uint32_t feeMode;
+    uint32_t reserved;
+};
+
+size_t padded(size_t bytes) {
+    return (bytes + 7) & ~static_cast<size_t>(7);
+}
+
+// multiply-xor over 8 byte words, a last partial word counts as zero padded
+uint64_t checksumUpdate(uint64_t hash, const char* data, size_t bytes) {
+    for (size_t i = 0; i < bytes; i += 8)
+    {
+        uint64_t word = 0;
+        memcpy(&word, data + i, min<size_t>(8, bytes - i));
+        hash ^= word;
+        hash *= 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+class SectionWriter {
+public:
+    explicit SectionWriter(ofstream& file_in) : file(file_in) {}
+
+    void write(const void* data, size_t bytes) {
+        static const char zeros[8] = {};
+        const char* bytesIn = static_cast<const char*>(data);
+        file.write(bytesIn, static_cast<streamsize>(bytes));
+        file.write(zeros, static_cast<streamsize>(padded(bytes) - bytes));
+        checksum = checksumUpdate(checksum, bytesIn, bytes);
+        size += padded(bytes);
+    }
+
+    uint64_t checksum = 0;
+    uint64_t size = 0;
+
+private:
+    ofstream& file;
+};
+
+class SectionReader {
+public:
+    SectionReader(const char* data_in, size_t size_in) : data(data_in), size(size_in) {}
+
+    const char* take(size_t bytes) {
+        if (padded(bytes) > size - pos) throw "Snapshot file is corrupt.\n";
+        const char* ans = data + pos;
+        pos += padded(bytes);
+        return ans;
+    }
+
+    template <typename T>
+    void copy(T* out, size_t count) {
+        if (count != 0) memcpy(out, take(count * sizeof(T)), count * sizeof(T));
+    }
+
+private:
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+};
+
+} // namespace
+
+void writeSnapshot(const string& filename, const BankState& state) {
+    ofstream file(filename, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        throw "Snapshot file failed to open.\n";
+    }
+
+    vector<PendingRecord> pending;
+    pending.reserve(state.unexecutedTransactions.size());
+    state.unexecutedTransactions.forEach([&](const Transaction& transaction) {
+        pending.push_back({transaction.executeDate, transaction.transactionID, transaction.amount,
+                           transaction.sender, transaction.recipient, static_cast<uint32_t>(transaction.feeMode), 0});
+    });
+
+    // sessions past the inline ones, grouped by account
+    vector<pair<uint32_t, uint64_t>> spilled;
+    state.sessions.forEachSpilled([&](uint32_t user, uint64_t key) { spilled.emplace_back(user, key); });
+    sort(spilled.begin(), spilled.end());
+    size_t spilledUsed = 0;
+
+    vector<UserRecord> records(state.users.size());
+    vector<uint32_t> history;
+    vector<uint32_t> sessionLengths;
+    string strings;
+    vector<BalanceCheckpoint> checkpoints;
+    vector<uint8_t> balances;
+    for (size_t id = 0; id < state.users.size(); id++)
+    {
+        const User& user = state.users[id];
+        string_view name = state.userNames.name(static_cast<uint32_t>(id));
+        UserRecord& record = records[id];
+        record.reg_timestamp = user.reg_timestamp;
+        record.stringOffset = strings.size();
+        record.balance = user.balance;
+        record.nameLength = static_cast<uint32_t>(name.size());
+        record.pinLength = static_cast<uint32_t>(user.pin.size());
+        record.sessionCount = user.activeSession.count;
+        record.incomingCount = static_cast<uint32_t>(user.incoming.size());
+        record.outcomingCount = static_cast<uint32_t>(user.outcoming.size());
+        record.checkpointCount = static_cast<uint32_t>(user.history.checkpointList().size());
+        record.balanceBytes = static_cast<uint32_t>(user.history.data().size());
+        strings += name;
+        strings += user.pin;
+        auto addSession = [&](uint64_t key) {
+            string IP = state.sessions.address(key);
+            sessionLengths.push_back(static_cast<uint32_t>(IP.size()));
+            strings += IP;
+        };
+        for (uint32_t i = 0; i < user.activeSession.inlineCount; i++) addSession(user.activeSession.ip[i]);
+        for (; spilledUsed < spilled.size() && spilled[spilledUsed].first == id; spilledUsed++) addSession(spilled[spilledUsed].second);
+        history.insert(history.end(), user.incoming.begin(), user.incoming.end());
+        history.insert(history.end(), user.outcoming.begin(), user.outcoming.end());
+        checkpoints.insert(checkpoints.end(), user.history.checkpointList().begin(), user.history.checkpointList().end());
+        balances.insert(balances.end(), user.history.data().begin(), user.history.data().end());
+    }
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.userCount = records.size();
+    header.pendingCount = pending.size();
+    header.transactionCount = state.transactions.size();
+    header.historyCount = history.size();
+    header.sessionCount = sessionLengths.size();
+    header.stringBytes = strings.size();
+    header.checkpointCount = checkpoints.size();
+    header.balanceBytes = balances.size();
+    header.recentPlace_timestamp = state.recentPlace_timestamp;
+    header.transactionID = state.transactionID;
+    header.transactionIDSuccessed = state.transactionIDSuccessed;
+    header.recentPlace_was_set = state.recentPlace_was_set;
+
+    // the header goes in last, once the checksum is known
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    SectionWriter sections(file);
+    sections.write(records.data(), records.size() * sizeof(UserRecord));
+    sections.write(pending.data(), pending.size() * sizeof(PendingRecord));
+    const TransactionLog& executed = state.transactions;
+    // a column is written a run at a time; archived runs are whole segments, a multiple of
+    // 8 bytes, so the pieces line up exactly as one write of the column would
+    auto writeColumn = [&](auto column, size_t width) {
+        executed.forEachRun([&](const TransactionColumns& run) { sections.write(column(run), run.count * width); });
+    };
+    writeColumn([](const TransactionColumns& run) { return run.executeDate; }, sizeof(uint64_t));
+    writeColumn([](const TransactionColumns& run) { return run.transactionID; }, sizeof(uint32_t));
+    writeColumn([](const TransactionColumns& run) { return run.amount; }, sizeof(uint32_t));
+    writeColumn([](const TransactionColumns& run) { return run.sender; }, sizeof(uint32_t));
+    writeColumn([](const TransactionColumns& run) { return run.recipient; }, sizeof(uint32_t));
+    writeColumn([](const TransactionColumns& run) { return run.feeMode; }, sizeof(FeeMode));
+    writeColumn([](const TransactionColumns& run) { return run.bankfee; }, sizeof(uint32_t));
+    // every run repeats the prefix the next one starts with, only the last one ends the column
+    writeColumn([](const TransactionColumns& run) { return run.feePrefix; }, sizeof(uint64_t));
+    uint64_t totalFee = executed.feePrefix(executed.size());
+    sections.write(&totalFee, sizeof(totalFee));
+    sections.write(history.data(), history.size() * sizeof(uint32_t));
+    sections.write(sessionLengths.data(), sessionLengths.size() * sizeof(uint32_t));
+    sections.write(strings.data(), strings.size());
+    sections.write(checkpoints.data(), checkpoints.size() * sizeof(BalanceCheckpoint));
+    sections.write(balances.data(), balances.size());
+
+    header.payloadSize = sections.size;
+    header.checksum = sections.checksum;
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    if (file.fail()) {
+        throw "Snapshot file failed to write.\n";
+    }
+}
+
+void readSnapshot(const string& filename, BankState& state) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw "Snapshot file failed to open.\n";
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        close(fd);
+        throw "Snapshot file is corrupt.\n";
+    }
+    size_t fileSize = static_cast<size_t>(st.st_size);
+    void* addr = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw "Snapshot file failed to open.\n";
+    }
+    const char* data = static_cast<const char*>(addr);
+
+    try
+    {
+        SnapshotHeader header;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.headerSize != sizeof(SnapshotHeader)) {
+            throw "Snapshot file is corrupt.\n";
+        }
+        if (header.version != SNAPSHOT_VERSION) {
+            throw "Snapshot version is not supported.\n";
+        }
+        const char* payload = data + sizeof(SnapshotHeader);
+        if (header.payloadSize != fileSize - sizeof(SnapshotHeader)
+            || checksumUpdate(0, payload, header.payloadSize) != header.checksum) {
+            throw "Snapshot file is corrupt.\n";
+        }
+
+        SectionReader sections(payload, header.payloadSize);
+        vector<UserRecord> records(header.userCount);
+        sections.copy(records.data(), records.size());
+        vector<PendingRecord> pending(header.pendingCount);
+        sections.copy(pending.data(), pending.size());
+        TransactionTable& executed = state.transactions.table();
+        executed.resize(header.transactionCount);
+        sections.copy(executed.executeDate.data(), executed.size());
+        sections.copy(executed.transactionID.data(), executed.size());
+        sections.copy(executed.amount.data(), executed.size());
+        sections.copy(executed.sender.data(), executed.size());
+        sections.copy(executed.recipient.data(), executed.size());
+        sections.copy(executed.feeMode.data(), executed.size());
+        sections.copy(executed.bankfee.data(), executed.size());
+        sections.copy(executed.feePrefix.data(), executed.feePrefix.size());
+        // the checksum only proves the file is what was written; the queries
+        // index users by these columns, so they must name accounts that exist
+        for (size_t i = 0; i < executed.size(); i++)
+        {
+            if (executed.sender[i] >= records.size() || executed.recipient[i] >= records.size()
+                || static_cast<uint32_t>(executed.feeMode[i]) > static_cast<uint32_t>(FeeMode::SPLIT)) {
+                throw "Snapshot file is corrupt.\n";
+            }
+        }
+        state.transactions.seal();
+        const char* history = sections.take(header.historyCount * sizeof(uint32_t));
+        vector<uint32_t> sessionLengths(header.sessionCount);
+        sections.copy(sessionLengths.data(), sessionLengths.size());
+        const char* strings = sections.take(header.stringBytes);
+        const char* checkpoints = sections.take(header.checkpointCount * sizeof(BalanceCheckpoint));
+        const char* balances = sections.take(header.balanceBytes);
+
+        state.users.reserve(records.size());
+        state.userNames.reserve(records.size());
+        size_t historyUsed = 0;
+        size_t sessionsUsed = 0;
+        size_t checkpointsUsed = 0;
+        size_t balancesUsed = 0;
+        for (const UserRecord& record : records)
+        {
+            uint64_t stringEnd = record.stringOffset + record.nameLength + record.pinLength;
+            if (stringEnd > header.stringBytes || sessionsUsed + record.sessionCount > header.sessionCount
+                || historyUsed + record.incomingCount + record.outcomingCount > header.historyCount
+                || checkpointsUsed + record.checkpointCount > header.checkpointCount || balancesUsed + record.balanceBytes > header.balanceBytes) {
+                throw "Snapshot file is corrupt.\n";
+            }
+            const char* text = strings + record.stringOffset;
+            if (!state.userNames.intern(string_view(text, record.nameLength)).second) {
+                throw "Snapshot file is corrupt.\n";
+            }
+            User& user = state.users.emplace_back(record.balance, string(text + record.nameLength, record.pinLength), record.reg_timestamp);
+
+            for (uint32_t i = 0; i < record.sessionCount; i++, sessionsUsed++)
+            {
+                if (stringEnd + sessionLengths[sessionsUsed] > header.stringBytes) {
+                    throw "Snapshot file is corrupt.\n";
+                }
+                uint32_t id = static_cast<uint32_t>(state.users.size() - 1);
+                string_view IP(strings + stringEnd, sessionLengths[sessionsUsed]);
+                state.sessions.insert(user.activeSession, id, state.sessions.intern(IP));
+                stringEnd += sessionLengths[sessionsUsed];
+            }
+            user.incoming.resize(record.incomingCount);
+            memcpy(user.incoming.data(), history + historyUsed * sizeof(uint32_t), record.incomingCount * sizeof(uint32_t));
+            historyUsed += record.incomingCount;
+            user.outcoming.resize(record.outcomingCount);
+            memcpy(user.outcoming.data(), history + historyUsed * sizeof(uint32_t), record.outcomingCount * sizeof(uint32_t));
+            historyUsed += record.outcomingCount;
+            // and the history lists index the log
+            for (const vector<uint32_t>* list : {&user.incoming, &user.outcoming}) {
+                for (uint32_t index : *list) {
+                    if (index >= header.transactionCount) throw "Snapshot file is corrupt.\n";
+                }
+            }
+
+            vector<BalanceCheckpoint> userCheckpoints(record.checkpointCount);
+            if (record.checkpointCount != 0) {
+                memcpy(userCheckpoints.data(), checkpoints + checkpointsUsed * sizeof(BalanceCheckpoint), record.checkpointCount * sizeof(BalanceCheckpoint));
+            }
+            checkpointsUsed += record.checkpointCount;
+            vector<uint8_t> userBalances(balances + balancesUsed, balances + balancesUsed + record.balanceBytes);
+            balancesUsed += record.balanceBytes;
+            if (!BalanceHistory::valid(userBalances, userCheckpoints)) {
+                throw "Snapshot file is corrupt.\n";
+            }
+            user.history.restore(move(userBalances), move(userCheckpoints));
+        }
+
+        for (const PendingRecord& record : pending)
+        {
+            if (record.sender >= records.size() || record.recipient >= records.size() || record.feeMode > static_cast<uint32_t>(FeeMode::SPLIT)) {
+                throw "Snapshot file is corrupt.\n";
+            }
+            Transaction transaction(record.executeDate, record.transactionID, record.amount, record.sender, record.recipient, static_cast<FeeMode>(record.feeMode));
+            transaction.bankfee = 0;
+            state.unexecutedTransactions.push(transaction);
+        }
+        state.transactionID = header.transactionID;
+        state.transactionIDSuccessed = header.transactionIDSuccessed;
+        state.recentPlace_was_set = header.recentPlace_was_set != 0;
+        state.recentPlace_timestamp = header.recentPlace_timestamp;
+    }
+    catch (const char*)
+    {
+        munmap(addr, fileSize);
+        throw;
+    }
+    munmap(addr, fileSize);
+}
@@ -0,0 +1,18 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include "bank_state.h"
+
+// Binary image of a BankState, so a restart can skip the registration file
+// and the command replay. The file is a fixed header followed by 8 byte
+// aligned sections of fixed size records (users, pending transactions, one
+// per column of the executed transactions, history indices, strings) copied
+// out of an mmap of the file in bulk. It is written in host byte order and
+// carries a format version and a checksum of everything after the header;
+// readSnapshot() throws on a mismatch instead of loading a damaged state.
+void writeSnapshot(const std::string& filename, const BankState& state);
+void readSnapshot(const std::string& filename, BankState& state);
+
+#endif
@@ -0,0 +1,61 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. head and tail only ever grow, each is written by one
+// side alone, and they sit on separate cache lines so the two sides do not
+// bounce a line between them on every item.
+template <typename T, size_t CAPACITY>
+class SpscRing {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    // producer side
+    bool tryPush(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == CAPACITY) return false;
+        items[t & (CAPACITY - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool tryPop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = items[h & (CAPACITY - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool empty() const {
+        return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) T items[CAPACITY];
+};
+
+// Wait step for a side that found its ring full or empty: spin briefly for
+// the short gaps, then give the core away so a single core machine still
+// makes progress, and sleep once the wait looks long (input from a terminal)
+// so an idle stage does not burn a core.
+inline void ringBackoff(unsigned& spins) {
+    if (++spins < 64) return;
+    if (spins < 1024) {
+        std::this_thread::yield();
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+#endif
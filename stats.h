@@ -0,0 +1,221 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef STATS_H
+#define STATS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Figures behind --stats and --stats-json.
+//
+// RunStats (load size and the time of each phase) is always collected. The
+// engine instrumentation (per command latency histograms, a counter for
+// every way a command can fail, drain sizes and the queue high-water mark)
+// only exists in a build with -DBANK_STATS (make stats); otherwise the
+// STATS_* macros expand to nothing and the engine carries no trace of it.
+
+struct RunStats
+{
+    size_t accounts = 0;
+    size_t registrationBytes = 0;
+    double registrationMs = 0;
+    size_t commands = 0;
+    double operationsMs = 0;
+    size_t queries = 0;
+    double queriesMs = 0;
+};
+
+inline double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void writeRunStatsJson(std::ostream& out, const RunStats& run) {
+    out << "  \"registration\": {\"accounts\": " << run.accounts << ", \"bytes\": " << run.registrationBytes
+        << ", \"ms\": " << run.registrationMs << "},\n"
+        << "  \"operations\": {\"commands\": " << run.commands << ", \"ms\": " << run.operationsMs << "},\n"
+        << "  \"queries\": {\"count\": " << run.queries << ", \"ms\": " << run.queriesMs << "}";
+}
+
+#ifdef BANK_STATS
+
+// Log-linear histogram in the style of HdrHistogram: values below 16 are
+// exact, above that every power of two is split into 16 buckets, so a
+// recorded value is off by at most 1/16. Buckets are atomic because the
+// queries record from the pool threads.
+class Histogram {
+public:
+    static constexpr unsigned SUB_BITS = 4;
+    static constexpr unsigned SUB_COUNT = 1 << SUB_BITS;
+    static constexpr unsigned BUCKETS = SUB_COUNT + (64 - SUB_BITS) * SUB_COUNT;
+
+    void record(uint64_t value) {
+        counts[index(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(value, std::memory_order_relaxed);
+        uint64_t seen = largest.load(std::memory_order_relaxed);
+        while (value > seen && !largest.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const {
+        uint64_t ans = 0;
+        for (const std::atomic<uint64_t>& bucket : counts) ans += bucket.load(std::memory_order_relaxed);
+        return ans;
+    }
+
+    uint64_t max() const { return largest.load(std::memory_order_relaxed); }
+    double mean() const { return count() == 0 ? 0 : static_cast<double>(total.load(std::memory_order_relaxed)) / static_cast<double>(count()); }
+
+    // lower end of the bucket holding the value at fraction q of the recorded ones
+    uint64_t percentile(double q) const {
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count()));
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < BUCKETS; i++)
+        {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen > rank) return lowest(i);
+        }
+        return max();
+    }
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> largest{0};
+
+    static unsigned index(uint64_t value) {
+        if (value < SUB_COUNT) return static_cast<unsigned>(value);
+        unsigned magnitude = 63 - static_cast<unsigned>(__builtin_clzll(value)); // at least SUB_BITS
+        unsigned shift = magnitude - SUB_BITS;
+        return SUB_COUNT + shift * SUB_COUNT + static_cast<unsigned>((value >> shift) & (SUB_COUNT - 1));
+    }
+
+    static uint64_t lowest(unsigned i) {
+        if (i < SUB_COUNT) return i;
+        unsigned shift = (i - SUB_COUNT) / SUB_COUNT;
+        return (uint64_t(SUB_COUNT) + (i - SUB_COUNT) % SUB_COUNT) << shift;
+    }
+};
+
+enum CommandKind { PLACE, LOGIN, OUT, BALANCE, LIST, REVENUE, HISTORY, SUMMARY, BALANCE_AS_OF, HISTORY_PAGE, TOP_ACCOUNTS, COMMAND_KINDS };
+
+constexpr const char* COMMAND_NAMES[COMMAND_KINDS] = {"place", "login", "out", "balance", "l", "r", "h", "s", "b", "p", "t"};
+
+#define ENGINE_COUNTERS(X) \
+    X(place_accepted) X(place_self) X(place_too_far) X(place_unknown_sender) X(place_unknown_recipient) \
+    X(place_not_registered) X(place_not_logged_in) X(place_fraud) \
+    X(executed) X(insufficient_funds) \
+    X(login_ok) X(login_failed) X(logout_ok) X(logout_failed) \
+    X(balance_ok) X(balance_unknown) X(balance_not_logged_in) X(balance_fraud)
+
+enum EngineCounter {
+#define STATS_ENUM(name) name,
+    ENGINE_COUNTERS(STATS_ENUM)
+#undef STATS_ENUM
+    ENGINE_COUNTER_COUNT
+};
+
+constexpr const char* COUNTER_NAMES[ENGINE_COUNTER_COUNT] = {
+#define STATS_NAME(name) #name,
+    ENGINE_COUNTERS(STATS_NAME)
+#undef STATS_NAME
+};
+
+struct EngineStats
+{
+    Histogram latency[COMMAND_KINDS]; // nanoseconds per command
+    Histogram drained; // transactions executed per updateToCurrentTimeStamp() call
+    uint64_t counters[ENGINE_COUNTER_COUNT] = {}; // only the command loop thread counts
+    size_t queueHighWater = 0;
+
+    void print(std::ostream& out) const {
+        out << "Latency (ns)        count        mean         p50         p90         p99       p99.9         max\n";
+        for (unsigned kind = 0; kind < COMMAND_KINDS; kind++) printRow(out, COMMAND_NAMES[kind], latency[kind]);
+        out << "Drained per call\n";
+        printRow(out, "transactions", drained);
+        out << "Pending queue high-water mark: " << queueHighWater << '\n';
+        out << "Counters\n";
+        for (unsigned i = 0; i < ENGINE_COUNTER_COUNT; i++) {
+            out << "  " << COUNTER_NAMES[i] << ' ' << counters[i] << '\n';
+        }
+    }
+
+    void writeJson(std::ostream& out) const {
+        out << "  \"engine\": {\n    \"latency_ns\": {";
+        for (unsigned kind = 0; kind < COMMAND_KINDS; kind++) {
+            out << (kind == 0 ? "\n" : ",\n") << "      \"" << COMMAND_NAMES[kind] << "\": ";
+            writeHistogram(out, latency[kind]);
+        }
+        out << "\n    },\n    \"drained_per_call\": ";
+        writeHistogram(out, drained);
+        out << ",\n    \"queue_high_water\": " << queueHighWater << ",\n    \"counters\": {";
+        for (unsigned i = 0; i < ENGINE_COUNTER_COUNT; i++) {
+            out << (i == 0 ? "\n" : ",\n") << "      \"" << COUNTER_NAMES[i] << "\": " << counters[i];
+        }
+        out << "\n    }\n  }";
+    }
+
+private:
+    static void printRow(std::ostream& out, const char* name, const Histogram& histogram) {
+        out.width(12);
+        out << std::left << name << std::right;
+        out.width(13);
+        out << histogram.count();
+        for (double q : {-1.0, 0.5, 0.9, 0.99, 0.999, 2.0})
+        {
+            out.width(12);
+            if (q < 0) out << histogram.mean();
+            else if (q > 1) out << histogram.max();
+            else out << histogram.percentile(q);
+        }
+        out << '\n';
+    }
+
+    static void writeHistogram(std::ostream& out, const Histogram& histogram) {
+        out << "{\"count\": " << histogram.count() << ", \"mean\": " << histogram.mean()
+            << ", \"p50\": " << histogram.percentile(0.5) << ", \"p90\": " << histogram.percentile(0.9)
+            << ", \"p99\": " << histogram.percentile(0.99) << ", \"p999\": " << histogram.percentile(0.999)
+            << ", \"max\": " << histogram.max() << "}";
+    }
+};
+
+// The stats of a single bank. Its commands count on one thread, and its
+// queries record their latency from the pool threads as well.
+inline EngineStats engineStats;
+
+// Where this thread records. A --batch thread points it at the stats of the
+// job it runs, so the jobs never share counters.
+inline thread_local EngineStats* threadStats = &engineStats;
+
+// records the lifetime of the enclosing scope into a latency histogram
+class ScopedLatency {
+public:
+    explicit ScopedLatency(CommandKind kind_in) : kind(kind_in), start(std::chrono::steady_clock::now()) {}
+    ~ScopedLatency() {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        threadStats->latency[kind].record(static_cast<uint64_t>(elapsed.count()));
+    }
+
+private:
+    CommandKind kind;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define STATS_TIME(kind) ScopedLatency statsLatency_(kind)
+#define STATS_COUNT(counter) (threadStats->counters[counter]++)
+#define STATS_QUEUE_DEPTH(depth) (threadStats->queueHighWater = std::max(threadStats->queueHighWater, static_cast<size_t>(depth)))
+#define STATS_DRAINED(n) (threadStats->drained.record(n))
+#define STATS_ONLY(...) __VA_ARGS__
+
+#else
+
+#define STATS_TIME(kind) ((void)0)
+#define STATS_COUNT(counter) ((void)0)
+#define STATS_QUEUE_DEPTH(depth) ((void)0)
+#define STATS_DRAINED(n) ((void)0)
+#define STATS_ONLY(...)
+
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data parallel loops. parallelFor() hands
+// out indices through a shared counter, so faster threads simply take more
+// of them, and the calling thread works too. With a single hardware thread
+// there are no workers and parallelFor() is a plain loop.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency()) {
+        for (unsigned i = 1; i < threads; i++) workers.emplace_back([this] { work(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // runs task(i) for every i in [0, n) and returns once all of them are done
+    void parallelFor(size_t n, const std::function<void(size_t)>& task) {
+        if (workers.empty()) {
+            for (size_t i = 0; i < n; i++) task(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = &task;
+            count = n;
+            next = 0;
+            busy = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        runTasks(task, n);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return busy == 0; });
+        current = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(size_t)>* current = nullptr;
+    size_t count = 0;
+    std::atomic<size_t> next{0};
+    size_t busy = 0;
+    unsigned long generation = 0;
+    bool stopping = false;
+
+    void runTasks(const std::function<void(size_t)>& task, size_t n) {
+        for (size_t i = next++; i < n; i = next++) task(i);
+    }
+
+    void work() {
+        unsigned long seen = 0;
+        while (true)
+        {
+            const std::function<void(size_t)>* task;
+            size_t n;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                task = current;
+                n = count;
+            }
+            runTasks(*task, n);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0) finished.notify_one();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,119 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the timestamp codec reads the digits as little endian words"
+#endif
+
+// Timestamps are YY:MM:DD:HH:MM:SS, 17 bytes, and stand for the decimal
+// number YYMMDDHHMMSS. The parser reads bytes 0-7 and 8-15 as two 64-bit
+// words and byte 16 on its own, and handles all digits of a word at once:
+// one compare checks its colons, a xor and two masks check that every other
+// byte is a digit, and one multiply-add turns each adjacent pair of digits
+// into its two digit field.
+//
+// word 0:  Y Y : M M : D D      word 1:  : H H : M M : S      byte 16:  S
+namespace timestamp_detail {
+
+constexpr uint64_t COLON_BYTES0 = 0x0000FF0000FF0000ULL;
+constexpr uint64_t COLONS0 = 0x00003A00003A0000ULL;
+constexpr uint64_t ZEROS0 = 0x3030003030003030ULL;
+constexpr uint64_t COLON_BYTES1 = 0x00FF0000FF0000FFULL;
+constexpr uint64_t COLONS1 = 0x003A00003A00003AULL;
+constexpr uint64_t ZEROS1 = 0x3000303000303000ULL;
+
+// digit values where the word had digits and zero where it had colons;
+// bad gets a bit set unless every one of those bytes was '0' to '9'
+inline uint64_t digitsOf(uint64_t word, uint64_t colonBytes, uint64_t colons, uint64_t zeros, uint64_t& bad) {
+    uint64_t digits = (word & ~colonBytes) ^ zeros;
+    bad |= ((word & colonBytes) ^ colons)
+         | (digits & 0xF0F0F0F0F0F0F0F0ULL) // not 0x30 to 0x3F
+         | ((digits + 0x0606060606060606ULL) & 0x1010101010101010ULL); // 0x3A to 0x3F
+    return digits;
+}
+
+// parses without branching on the input, bad collects what was wrong
+inline uint64_t parse(const char* text, uint64_t& bad) {
+    uint64_t word0, word1;
+    memcpy(&word0, text, 8);
+    memcpy(&word1, text + 8, 8);
+    uint64_t last = static_cast<unsigned char>(text[16]) - uint64_t('0');
+    bad |= last & ~uint64_t(0xF);
+    bad |= (last + 6) & 0x10;
+
+    // byte i of pairs is 10 * digit i + digit i + 1, the digits are at most 9 so nothing carries
+    uint64_t digits0 = digitsOf(word0, COLON_BYTES0, COLONS0, ZEROS0, bad);
+    uint64_t digits1 = digitsOf(word1, COLON_BYTES1, COLONS1, ZEROS1, bad);
+    uint64_t pairs0 = digits0 * 10 + (digits0 >> 8);
+    uint64_t pairs1 = digits1 * 10 + (digits1 >> 8);
+
+    // YY, MM and DD sit at bits 0, 24 and 48 of pairs0, and HH, MM and the
+    // tens of SS at bits 8, 32 and 56 of pairs1. One wide multiply lines up
+    // each field times its power of 100 at bit 48, or 56, with every other
+    // partial product below that bit or above the 20 bits of the result.
+    constexpr uint64_t WEIGHTS = (uint64_t(10000) << 48) + (uint64_t(100) << 24) + 1;
+    uint64_t date = static_cast<uint64_t>((static_cast<__uint128_t>(pairs0 & 0x00FF0000FF0000FFULL) * WEIGHTS) >> 48) & 0xFFFFF;
+    uint64_t time = static_cast<uint64_t>((static_cast<__uint128_t>(pairs1 & 0xFF0000FF0000FF00ULL) * WEIGHTS) >> 56) & 0xFFFFF;
+    return date * 1000000 + time + last;
+}
+
+// the two digit fields of n < 1000000 as a 0.48 fixed point fraction of
+// 10000 taken apart a hundred at a time; the reciprocal is rounded up and
+// its error stays far below one step of 2^48 / 100
+inline void splitSix(uint64_t n, uint32_t* fields) {
+    constexpr uint64_t ONE = uint64_t(1) << 48;
+    constexpr uint64_t RECIPROCAL = ONE / 10000 + 1;
+    uint64_t fraction = n * RECIPROCAL;
+    fields[0] = static_cast<uint32_t>(fraction >> 48);
+    fraction = (fraction & (ONE - 1)) * 100;
+    fields[1] = static_cast<uint32_t>(fraction >> 48);
+    fraction = (fraction & (ONE - 1)) * 100;
+    fields[2] = static_cast<uint32_t>(fraction >> 48);
+}
+
+} // namespace timestamp_detail
+
+// false if text is not exactly YY:MM:DD:HH:MM:SS
+inline bool parseTimeStamp(std::string_view text, uint64_t& value) {
+    if (text.size() != 17) return false;
+    uint64_t bad = 0;
+    value = timestamp_detail::parse(text.data(), bad);
+    return bad == 0;
+}
+
+// parses count timestamps, only checking the lengths on the way and all the
+// digits and colons once at the end; false if any of them is malformed, and
+// values is unspecified then
+inline bool parseTimeStamps(const std::string_view* texts, size_t count, uint64_t* values) {
+    uint64_t bad = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (texts[i].size() != 17) return false;
+        values[i] = timestamp_detail::parse(texts[i].data(), bad);
+    }
+    return bad == 0;
+}
+
+// the six fields of any value, years first: two digits each, except the
+// years, which are everything above the low ten digits. Below 10^12 that
+// is a single division, which the compiler turns into a multiplication;
+// larger values, such as an interval that wrapped around, take the years
+// off with one more first.
+inline void splitTimeStamp(uint64_t value, uint32_t* fields) {
+    uint64_t years = 0;
+    if (value >= 1000000000000ULL) {
+        years = value / 10000000000ULL;
+        value -= years * 10000000000ULL;
+    }
+    uint64_t date = value / 1000000;
+    timestamp_detail::splitSix(date, fields);
+    timestamp_detail::splitSix(value - date * 1000000, fields + 3);
+    fields[0] += static_cast<uint32_t>(years); // splitSix left 0 there if years were taken off
+}
+
+#endif
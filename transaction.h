@@ -0,0 +1,38 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+#include <cstdint>
+
+// who pays the bank fee, the place command's 'o' (sender only) or 's' (split);
+// any other mode charges both sides the full fee
+enum class FeeMode : uint8_t { BOTH, SENDER, SPLIT };
+
+struct Transaction
+{
+    uint64_t executeDate;
+    unsigned int transactionID;
+    unsigned int amount;
+    uint32_t sender; // account ids, see NameTable
+    uint32_t recipient;
+    FeeMode feeMode;
+    unsigned bankfee;
+    Transaction() = default;
+    Transaction(uint64_t execDate, unsigned int transID, unsigned int amt, 
+                uint32_t sndr, uint32_t rcpt, FeeMode fee)
+        : executeDate(execDate), transactionID(transID), amount(amt), 
+          sender(sndr), recipient(rcpt), feeMode(fee) {}
+};
+
+// execution order of pending transactions: earliest executeDate first, ties by transactionID
+struct SortByExecuteDate 
+{
+    bool operator()(const Transaction &left, const Transaction &right) const {
+        if (left.executeDate == right.executeDate) {
+            return left.transactionID > right.transactionID;
+        }
+        return left.executeDate > right.executeDate;
+    }
+};
+
+#endif
@@ -0,0 +1,152 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "transaction_log.h"
+
+using namespace std;
+
+namespace {
+
+constexpr char SEGMENT_MAGIC[8] = {'2', '8', '1', 'B', 'A', 'N', 'K', 'A'};
+constexpr uint32_t SEGMENT_VERSION = 1;
+
+// makes a segment file readable on its own, the process keeps these figures in memory
+struct SegmentHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t first;
+    uint64_t count;
+    uint64_t minDate;
+    uint64_t maxDate;
+};
+
+size_t padded(size_t bytes) {
+    return (bytes + 7) & ~static_cast<size_t>(7);
+}
+
+template <typename T>
+void eraseFront(vector<T>& column, size_t n) {
+    column.erase(column.begin(), column.begin() + static_cast<ptrdiff_t>(n));
+}
+
+} // namespace
+
+void TransactionTable::eraseFront(size_t n) {
+    if (n == size()) {
+        uint64_t total = feePrefix[n];
+        resize(0);
+        feePrefix[0] = total;
+        return;
+    }
+    ::eraseFront(executeDate, n);
+    ::eraseFront(transactionID, n);
+    ::eraseFront(amount, n);
+    ::eraseFront(sender, n);
+    ::eraseFront(recipient, n);
+    ::eraseFront(feeMode, n);
+    ::eraseFront(bankfee, n);
+    ::eraseFront(feePrefix, n);
+}
+
+Segment::Segment(const string& filename, const TransactionTable& table, size_t offset, size_t count, size_t first) {
+    // header, then the columns in TransactionColumns order, each 8 byte aligned
+    const void* columns[] = {table.executeDate.data() + offset, table.transactionID.data() + offset, table.amount.data() + offset,
+                             table.sender.data() + offset, table.recipient.data() + offset, table.feeMode.data() + offset,
+                             table.bankfee.data() + offset, table.feePrefix.data() + offset};
+    const size_t bytes[] = {count * sizeof(uint64_t), count * sizeof(uint32_t), count * sizeof(uint32_t),
+                            count * sizeof(uint32_t), count * sizeof(uint32_t), count * sizeof(FeeMode),
+                            count * sizeof(uint32_t), (count + 1) * sizeof(uint64_t)};
+    size_t columnStart[8];
+    size_t total = sizeof(SegmentHeader);
+    for (size_t c = 0; c < 8; c++) {
+        columnStart[c] = total;
+        total += padded(bytes[c]);
+    }
+
+    vector<char> image(total, 0);
+    SegmentHeader header = {};
+    memcpy(header.magic, SEGMENT_MAGIC, sizeof(header.magic));
+    header.version = SEGMENT_VERSION;
+    header.headerSize = sizeof(SegmentHeader);
+    header.first = first;
+    header.count = count;
+    header.minDate = table.executeDate[offset];
+    header.maxDate = table.executeDate[offset + count - 1];
+    memcpy(image.data(), &header, sizeof(header));
+    for (size_t c = 0; c < 8; c++) memcpy(image.data() + columnStart[c], columns[c], bytes[c]);
+
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw "Archive segment failed to open.\n";
+    }
+    size_t written = 0;
+    while (written < total)
+    {
+        ssize_t n = write(fd, image.data() + written, total - written);
+        if (n < 0) {
+            close(fd);
+            throw "Archive segment failed to write.\n";
+        }
+        written += static_cast<size_t>(n);
+    }
+    mapping = mmap(nullptr, total, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw "Archive segment failed to map.\n";
+    }
+    mappedBytes = total;
+    // lookups jump around, reading ahead would page in what no query asked for
+    madvise(mapping, mappedBytes, MADV_RANDOM);
+
+    const char* base = static_cast<const char*>(mapping);
+    view.first = first;
+    view.count = count;
+    view.executeDate = reinterpret_cast<const uint64_t*>(base + columnStart[0]);
+    view.transactionID = reinterpret_cast<const uint32_t*>(base + columnStart[1]);
+    view.amount = reinterpret_cast<const uint32_t*>(base + columnStart[2]);
+    view.sender = reinterpret_cast<const uint32_t*>(base + columnStart[3]);
+    view.recipient = reinterpret_cast<const uint32_t*>(base + columnStart[4]);
+    view.feeMode = reinterpret_cast<const FeeMode*>(base + columnStart[5]);
+    view.bankfee = reinterpret_cast<const uint32_t*>(base + columnStart[6]);
+    view.feePrefix = reinterpret_cast<const uint64_t*>(base + columnStart[7]);
+    lastDate = header.maxDate;
+    for (size_t i = 0; i < count; i += INDEX_STRIDE) index.push_back(table.executeDate[offset + i]);
+}
+
+Segment::~Segment() {
+    if (mapping != nullptr) munmap(mapping, mappedBytes);
+}
+
+void TransactionLog::seal() {
+    if (directory.empty()) return;
+    size_t full = resident.size() / SEGMENT_SIZE;
+    if (full == 0) return;
+    for (size_t k = 0; k < full; k++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "/segment-%06zu.bin", segments.size());
+        segments.push_back(make_unique<Segment>(directory + name, resident, k * SEGMENT_SIZE, SEGMENT_SIZE, residentStart + k * SEGMENT_SIZE));
+    }
+    resident.eraseFront(full * SEGMENT_SIZE);
+    residentStart += full * SEGMENT_SIZE;
+}
+
+void TransactionLog::buildTotals() const {
+    lock_guard<mutex> lock(totalsMutex);
+    if (totalsKept.load(memory_order_relaxed)) return; // another query thread built them
+    daily.clear();
+    forEachRun([this](const TransactionColumns& run) {
+        for (size_t k = 0; k < run.count; k++) {
+            Transaction transaction(run.executeDate[k], run.transactionID[k], run.amount[k], run.sender[k], run.recipient[k], run.feeMode[k]);
+            transaction.bankfee = run.bankfee[k];
+            daily.add(transaction);
+        }
+    });
+    totalsKept.store(true, memory_order_release);
+}
@@ -0,0 +1,241 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef TRANSACTION_LOG_H
+#define TRANSACTION_LOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "daily_totals.h"
+#include "transaction.h"
+
+// Read-only view of the columns of a run of consecutive executed
+// transactions, [first, first + count). feePrefix has count + 1 entries and,
+// like every fee prefix here, counts from the very first transaction.
+struct TransactionColumns
+{
+    size_t first = 0;
+    size_t count = 0;
+    const uint64_t* executeDate = nullptr;
+    const uint32_t* transactionID = nullptr;
+    const uint32_t* amount = nullptr;
+    const uint32_t* sender = nullptr;
+    const uint32_t* recipient = nullptr;
+    const FeeMode* feeMode = nullptr;
+    const uint32_t* bankfee = nullptr;
+    const uint64_t* feePrefix = nullptr;
+};
+
+// The columns of the transactions that are still in memory.
+struct TransactionTable
+{
+    std::vector<uint64_t> executeDate;
+    std::vector<uint32_t> transactionID;
+    std::vector<uint32_t> amount;
+    std::vector<uint32_t> sender;
+    std::vector<uint32_t> recipient;
+    std::vector<FeeMode> feeMode;
+    std::vector<uint32_t> bankfee;
+    std::vector<uint64_t> feePrefix = std::vector<uint64_t>(1, 0);
+
+    size_t size() const { return executeDate.size(); }
+
+    void push_back(const Transaction& transaction) {
+        executeDate.push_back(transaction.executeDate);
+        transactionID.push_back(transaction.transactionID);
+        amount.push_back(transaction.amount);
+        sender.push_back(transaction.sender);
+        recipient.push_back(transaction.recipient);
+        feeMode.push_back(transaction.feeMode);
+        bankfee.push_back(transaction.bankfee);
+        feePrefix.push_back(feePrefix.back() + transaction.bankfee);
+    }
+
+    // makes room for n transactions whose columns are filled in place
+    void resize(size_t n) {
+        executeDate.resize(n);
+        transactionID.resize(n);
+        amount.resize(n);
+        sender.resize(n);
+        recipient.resize(n);
+        feeMode.resize(n);
+        bankfee.resize(n);
+        feePrefix.resize(n + 1);
+    }
+
+    // drops the first n transactions, feePrefix keeps its absolute values;
+    // dropping all of them moves nothing
+    void eraseFront(size_t n);
+
+    TransactionColumns columns(size_t first) const {
+        TransactionColumns ans;
+        ans.first = first;
+        ans.count = size();
+        ans.executeDate = executeDate.data();
+        ans.transactionID = transactionID.data();
+        ans.amount = amount.data();
+        ans.sender = sender.data();
+        ans.recipient = recipient.data();
+        ans.feeMode = feeMode.data();
+        ans.bankfee = bankfee.data();
+        ans.feePrefix = feePrefix.data();
+        return ans;
+    }
+};
+
+// A sealed run of SEGMENT_SIZE transactions in its own file, mapped read
+// only. The dates it covers and a sparse index of every INDEX_STRIDE-th
+// executeDate stay in memory, so a lookup pages in one block of the date
+// column instead of binary searching through the whole file.
+class Segment {
+public:
+    static constexpr size_t INDEX_STRIDE = 256;
+
+    // writes table's transactions [offset, offset + count), which are log indices from first on
+    Segment(const std::string& filename, const TransactionTable& table, size_t offset, size_t count, size_t first);
+    ~Segment();
+
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    const TransactionColumns& columns() const { return view; }
+    uint64_t minDate() const { return view.executeDate[0]; }
+    uint64_t maxDate() const { return lastDate; }
+
+    // offset of the first transaction executed at or after date
+    size_t lowerBound(uint64_t date) const {
+        // index[b] is the date of offset b * INDEX_STRIDE
+        size_t block = static_cast<size_t>(std::lower_bound(index.begin(), index.end(), date) - index.begin());
+        size_t from = (block == 0) ? 0 : (block - 1) * INDEX_STRIDE;
+        size_t to = std::min(view.count, block * INDEX_STRIDE + 1);
+        return static_cast<size_t>(std::lower_bound(view.executeDate + from, view.executeDate + to, date) - view.executeDate);
+    }
+
+private:
+    void* mapping = nullptr;
+    size_t mappedBytes = 0;
+    TransactionColumns view;
+    uint64_t lastDate = 0;
+    std::vector<uint64_t> index;
+};
+
+// The executed transactions in execution order, one column per field. The
+// queries touch few fields of many transactions: a range lookup only binary
+// searches executeDate and revenue only reads feePrefix, so each of them
+// walks a dense array instead of striding over whole records.
+//
+// With archiveTo() every full SEGMENT_SIZE run of transactions is sealed
+// into a Segment file and leaves memory, so only the newest run and a few
+// words per segment stay resident however long the history grows. Index i
+// lives in segment i / SEGMENT_SIZE, which is how the history lists of the
+// users resolve into segments. Range lookups skip the segments outside the
+// range by their dates and only touch pages of the ones they cross.
+//
+// The per-day totals of every account (DailyTotals) are only summed up when
+// the first t query asks for them, and kept up to date from then on, so a
+// run without t queries carries none of them.
+class TransactionLog {
+public:
+    static constexpr size_t SEGMENT_SHIFT = 16;
+    static constexpr size_t SEGMENT_SIZE = size_t(1) << SEGMENT_SHIFT;
+
+    TransactionLog() = default;
+    TransactionLog(const TransactionLog&) = delete;
+    TransactionLog& operator=(const TransactionLog&) = delete;
+
+    // seals full runs into segment files in directory from now on
+    void archiveTo(const std::string& directory_in) { directory = directory_in; }
+
+    size_t size() const { return residentStart + resident.size(); }
+
+    void push_back(const Transaction& transaction) {
+        resident.push_back(transaction);
+        if (totalsKept.load(std::memory_order_relaxed)) daily.add(transaction);
+        if (!directory.empty() && resident.size() >= SEGMENT_SIZE) seal();
+    }
+
+    // for loading the whole log at once: fill resize(n)'s columns, then call seal()
+    TransactionTable& table() { return resident; }
+
+    // moves every full run of the resident columns into segment files, if
+    // archiving. A growing log seals each run the moment it fills, so no
+    // rows are left behind to shift; only a log loaded through table() keeps
+    // a partial run, which moves to the front once.
+    void seal();
+
+    // the daily totals, summed up from the transactions on the first call;
+    // safe to call from several query threads at once
+    const DailyTotals& dailyTotals() const {
+        if (!totalsKept.load(std::memory_order_acquire)) buildTotals();
+        return daily;
+    }
+
+    // empties the log, the resident columns keep their capacity
+    void clear() {
+        segments.clear();
+        resident.resize(0);
+        resident.feePrefix[0] = 0;
+        residentStart = 0;
+        daily.clear();
+        totalsKept.store(false, std::memory_order_relaxed);
+    }
+
+    uint64_t executeDate(size_t i) const { return isResident(i) ? resident.executeDate[i - residentStart] : at(i).executeDate[offset(i)]; }
+    uint32_t transactionID(size_t i) const { return isResident(i) ? resident.transactionID[i - residentStart] : at(i).transactionID[offset(i)]; }
+    uint32_t amount(size_t i) const { return isResident(i) ? resident.amount[i - residentStart] : at(i).amount[offset(i)]; }
+    uint32_t sender(size_t i) const { return isResident(i) ? resident.sender[i - residentStart] : at(i).sender[offset(i)]; }
+    uint32_t recipient(size_t i) const { return isResident(i) ? resident.recipient[i - residentStart] : at(i).recipient[offset(i)]; }
+    FeeMode feeMode(size_t i) const { return isResident(i) ? resident.feeMode[i - residentStart] : at(i).feeMode[offset(i)]; }
+    uint32_t bankfee(size_t i) const { return isResident(i) ? resident.bankfee[i - residentStart] : at(i).bankfee[offset(i)]; }
+
+    // total bankfee of [0, i), i may be size()
+    uint64_t feePrefix(size_t i) const {
+        return isResident(i) ? resident.feePrefix[i - residentStart] : at(i).feePrefix[offset(i)];
+    }
+
+    // index of the first transaction executed at or after date
+    size_t lowerBound(uint64_t date) const {
+        // the first segment that reaches date holds the answer, unless none does
+        auto segment = std::lower_bound(segments.begin(), segments.end(), date,
+            [](const std::unique_ptr<Segment>& left, uint64_t right) { return left->maxDate() < right; });
+        if (segment != segments.end()) {
+            return static_cast<size_t>(segment - segments.begin()) * SEGMENT_SIZE + (*segment)->lowerBound(date);
+        }
+        const std::vector<uint64_t>& dates = resident.executeDate;
+        return residentStart + static_cast<size_t>(std::lower_bound(dates.begin(), dates.end(), date) - dates.begin());
+    }
+
+    // total bankfee of [first, last), with the same wrap around as adding the fees up in an unsigned int
+    unsigned int feeBetween(size_t first, size_t last) const {
+        return static_cast<unsigned int>(feePrefix(last) - feePrefix(first));
+    }
+
+    // visits the columns of every segment in order, then the resident ones
+    template <typename Visit>
+    void forEachRun(Visit visit) const {
+        for (const std::unique_ptr<Segment>& segment : segments) visit(segment->columns());
+        visit(resident.columns(residentStart));
+    }
+
+private:
+    std::string directory; // empty: everything stays in memory
+    std::vector<std::unique_ptr<Segment>> segments;
+    TransactionTable resident; // transactions [residentStart, size())
+    size_t residentStart = 0;
+    // appended to by push_back() only once a query made dailyTotals() build them
+    mutable DailyTotals daily;
+    mutable std::atomic<bool> totalsKept{false};
+    mutable std::mutex totalsMutex;
+
+    void buildTotals() const;
+
+    bool isResident(size_t i) const { return i >= residentStart; }
+    const TransactionColumns& at(size_t i) const { return segments[i >> SEGMENT_SHIFT]->columns(); }
+    static size_t offset(size_t i) { return i & (SEGMENT_SIZE - 1); }
+};
+
+#endif
@@ -0,0 +1,76 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef USER_H
+#define USER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "balance_history.h"
+#include "engine_log.h"
+#include "output_writer.h"
+#include "session_store.h"
+#include "stats.h"
+
+class User {
+public:
+    unsigned int balance;
+    std::string pin;
+    uint64_t reg_timestamp;
+    Sessions activeSession; // keys from SessionStore
+    std::vector<unsigned int> incoming; // store index in transactions when self as recipient
+    std::vector<unsigned int> outcoming; // store index in transactions when self as sende 
+    BalanceHistory history; // every balance since registration
+    User() = default;
+    User(unsigned int bal, std::string p, uint64_t reg_time) 
+        : balance(bal), pin(p), reg_timestamp(reg_time), history(reg_time, bal) {}
+
+    // an executed transaction took paid from the balance and gave it received
+    void recordBalance(uint64_t executeDate, unsigned int paid, unsigned int received, size_t checkpointEvery) {
+        history.record(executeDate, history.latest() - paid + received, checkpointEvery);
+    }
+    
+    template <typename Log>
+    void Login(std::string_view USER_ID, uint32_t id, uint64_t IP, SessionStore& sessions, Log& log, OutputWriter& output) {
+        sessions.insert(activeSession, id, IP);
+        STATS_COUNT(login_ok);
+        log.loggedIn(USER_ID, id, IP, output);
+    }
+
+    template <typename Log>
+    void Logout(std::string_view USER_ID, uint32_t id, uint64_t IP, SessionStore& sessions, Log& log, OutputWriter& output) {
+        if (sessions.erase(activeSession, id, IP))
+        {   
+            STATS_COUNT(logout_ok);
+            log.loggedOut(USER_ID, id, IP, output);
+        } else {
+            STATS_COUNT(logout_failed);
+            log.rejected(RejectReason::LOGOUT_FAILED, USER_ID, id, IP, output);
+        }
+    }
+
+    template <typename Log>
+    void Balance(std::string_view ACCOUNT, uint32_t id, uint64_t IP, const SessionStore& sessions, Log& log, bool recentPlace_was_set, uint64_t recentPlace_timestamp, OutputWriter& output) {
+        if (activeSession.empty()) {
+            STATS_COUNT(balance_not_logged_in);
+            log.rejected(RejectReason::BALANCE_NOT_LOGGED_IN, ACCOUNT, id, IP, output);
+        } else if (sessions.contains(activeSession, id, IP)) {
+            STATS_COUNT(balance_ok);
+            uint64_t balance_timestamp;
+            if (recentPlace_was_set)
+            {
+                balance_timestamp = recentPlace_timestamp;
+            } else {
+                balance_timestamp = reg_timestamp;
+            }
+            output << "As of " << balance_timestamp << ", " << ACCOUNT << " has a balance of $" << balance << ".\n";
+        } else {
+            STATS_COUNT(balance_fraud);
+            log.rejected(RejectReason::BALANCE_FRAUD, ACCOUNT, id, IP, output);
+        }
+        
+    }
+
+};
+
+#endif
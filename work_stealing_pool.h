@@ -0,0 +1,102 @@
+// Project identifier: 292F24D17A4455C1B5133EDD8C7CEAA0C9570A98
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs independent tasks of very different sizes, such as whole banks, on
+// a fixed number of threads. The tasks are dealt out round robin in the
+// order given, so with the largest first every thread starts on a large
+// one. A thread works through its own deque from the front; once it runs
+// dry it steals the back half of the fullest other deque, so the small
+// tasks at the end even out whatever the large ones left uneven. Each
+// thread has its own lock, only a steal ever touches two of them.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threads_in = std::thread::hardware_concurrency())
+        : threads(std::max(threads_in, 1u)) {}
+
+    unsigned size() const { return threads; }
+
+    // runs task(worker, i) for every i in order, worker in [0, size()) being
+    // the thread that runs it, and returns once all of them are done; the
+    // calling thread is worker 0
+    void run(const std::vector<size_t>& order, const std::function<void(unsigned, size_t)>& task) {
+        std::vector<Queue> queues(threads);
+        for (size_t i = 0; i < order.size(); i++) queues[i % threads].items.push_back(order[i]);
+
+        std::vector<std::thread> workers;
+        for (unsigned worker = 1; worker < threads; worker++) {
+            workers.emplace_back([&, worker] { work(queues, worker, task); });
+        }
+        work(queues, 0, task);
+        for (std::thread& thread : workers) thread.join();
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<size_t> items;
+    };
+
+    unsigned threads;
+
+    static void work(std::vector<Queue>& queues, unsigned worker, const std::function<void(unsigned, size_t)>& task) {
+        Queue& own = queues[worker];
+        while (true)
+        {
+            bool found = false;
+            size_t next = 0;
+            {
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.items.empty()) {
+                    found = true;
+                    next = own.items.front();
+                    own.items.pop_front();
+                }
+            }
+            if (found) {
+                task(worker, next);
+            } else if (!steal(queues, worker)) {
+                // nothing is ever added, so once every deque looks empty the
+                // only tasks left are ones other threads are already running
+                return;
+            }
+        }
+    }
+
+    static bool steal(std::vector<Queue>& queues, unsigned worker) {
+        size_t victim = queues.size(), most = 0;
+        for (size_t i = 0; i < queues.size(); i++) {
+            if (i == worker) continue;
+            std::lock_guard<std::mutex> lock(queues[i].mutex);
+            if (queues[i].items.size() > most) {
+                most = queues[i].items.size();
+                victim = i;
+            }
+        }
+        if (victim == queues.size()) return false;
+
+        std::deque<size_t> taken;
+        {
+            std::lock_guard<std::mutex> lock(queues[victim].mutex);
+            std::deque<size_t>& items = queues[victim].items;
+            size_t half = (items.size() + 1) / 2;
+            taken.assign(items.end() - static_cast<std::ptrdiff_t>(half), items.end());
+            items.resize(items.size() - half);
+        }
+        // the victim may have emptied in between, then look again
+        std::lock_guard<std::mutex> lock(queues[worker].mutex);
+        queues[worker].items.insert(queues[worker].items.end(), taken.begin(), taken.end());
+        return true;
+    }
+};
+
+#endif